@@ -7,13 +7,69 @@ Footprint = a candlestick that contains traded bid and ask volume at various pri
 
 #include "defs.hpp"
 #include "data.hpp"
+#include "source.hpp"
 #include "level_info.hpp"
 #include "candlestick.hpp"
+#include "chart.hpp"
+#include "scheduler.hpp"
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <charconv>
+#include <atomic>
+#include <exception>
+#include <queue>
+#include <chrono>
+#include <filesystem>
 #include "datahandler.hpp"
 
+#ifdef ORDERFLOW_STATS
+#define ORDERFLOW_STAT(...) __VA_ARGS__
+#else
+#define ORDERFLOW_STAT(...)
+#endif
+
 namespace aggregator{
 
+    /*Counters and timers of the stages of the aggregation pipeline. They are only filled when the library is compiled with
+    ORDERFLOW_STATS defined. Otherwise the instrumentation is compiled out and every field stays 0.
+    */
+    struct Stats{
+        size_t rows_parsed = 0; // Rows returned by the data handler
+        size_t bytes_read = 0; // Size of the input file (compressed size for archives)
+        size_t queue_high_water = 0; // Maximum number of parsed rows waiting in the queue
+        size_t candles_emitted = 0;
+        size_t bytes_written = 0; // Only for aggregate_store()
+        std::chrono::nanoseconds parse_time{0}; // Time spent in the data handler (reader thread)
+        std::chrono::nanoseconds producer_stall{0}; // Time spent pushing to the queue, mostly waiting for its lock (reader thread)
+        std::chrono::nanoseconds consumer_stall{0}; // Time spent waiting for the queue to be filled (aggregating thread)
+        std::chrono::nanoseconds level_time{0}; // Time spent adding rows to the footprint i.e __set_price_level__
+        std::chrono::nanoseconds write_time{0}; // Time spent emitting candles i.e copying them to the writer thread, or constructing CandleStick
+        std::chrono::nanoseconds total_time{0};
+
+        friend std::ostream &operator<<(std::ostream &out, const Stats &obj){
+            auto ms = [](std::chrono::nanoseconds x){return x.count()/1e6;};
+            out << "rows parsed : " << obj.rows_parsed << "\tbytes read : " << obj.bytes_read << "\tcandles : " << obj.candles_emitted
+            << "\tbytes written : " << obj.bytes_written << "\tqueue high water : " << obj.queue_high_water
+            << "\nparse : " << ms(obj.parse_time) << " ms\tproducer stall : " << ms(obj.producer_stall) << " ms\tconsumer stall : "
+            << ms(obj.consumer_stall) << " ms\tlevels : " << ms(obj.level_time) << " ms\twrite : " << ms(obj.write_time)
+            << " ms\ttotal : " << ms(obj.total_time) << " ms\n";
+            return out;
+        }
+    };
+
+    /*A source of time and sales data merged by aggregate_merged() e.g the spot or the perpetual market of an asset
+    @param path location of the file
+    @param handler data handler of the file
+    @param skip number of lines to skip at the start of the file
+    */
+    struct Feed{
+        std::string path;
+        RowData (*handler) (data::FileStream &);
+        size_t skip = 0;
+    };
+
     namespace {
 
         /*@brief Checks if two time are within the same time interval.
@@ -33,7 +89,7 @@ namespace aggregator{
         @param row unordered map containing the row that was read
         @param price_interval price interval between each price level. It determines each price level of the footprint
         */
-        inline void __set_price_level__(std::map<Price, Level, std::greater<Price>> &footprint, const RowData &row,
+        inline void __set_price_level__(Footprint &footprint, const RowData &row,
                 const Price &price_interval){
            
             Price level = ((int)(row.price/price_interval + 1)) * price_interval; //Upper bounded level
@@ -44,19 +100,179 @@ namespace aggregator{
             
         }
 
-        inline void __write__(data::FileStream &out, Price &open, Price &high, Price &low, Price &close, time_t &time, std::map<Price, Level, std::greater<Price>> &footprint){
-            out << open << ' ' << high << ' ' << low << ' ' << close << ' ' << time << ' ' << footprint.size();
-            for (auto &p : footprint){
-                out << ' ' << p.second;
+        /*@brief Writes candles in the text form of CandleStick::operator<< on a dedicated thread, so the aggregating thread never formats
+        them or waits for the disk. Candles are copied to a batch of flat arrays. When the writer thread is idle it takes the whole batch,
+        formats it with std::to_chars into a reusable buffer and writes it, while the next batch is filled. The two batches are swapped,
+        so no memory is allocated once they are large enough.
+        @param path file to write to. The constructor throws if it can't be opened
+        */
+        class __Writer__{
+        public:
+            __Writer__(const std::string &path){
+                _file.open_except(path, std::ios::out);
+                _thread = std::thread(&__Writer__::_loop, this);
             }
-            out << '\n';
-        }
 
+            ~__Writer__(){
+                if (!_thread.joinable()) return;
+                try {
+                    close();
+                }
+                catch (...) {}
+            }
+
+            void add(Price open, Price high, Price low, Price close, time_t time, const Footprint &footprint){
+                _filling.candles.push_back(_Candle{open, high, low, close, time, footprint.size()});
+                for (auto &p : footprint) _filling.levels.push_back(p.second);
+                if (_filling.candles.size()+_filling.levels.size() >= _batch_size && !_busy.load()) _hand_over(false);
+            }
+
+            void add(CandleStick &c){
+                add(c.open(), c.high(), c.low(), c.close(), c.timestamp(), c.footprint());
+            }
+
+            /*Writes the remaining candles and stops the writer thread. Rethrows the error of the writer thread
+            @return number of bytes written
+            */
+            size_t close(){
+                {
+                    std::unique_lock<std::mutex> lock(_mut);
+                    _cv.wait(lock, [&](){return !_busy.load();});
+                }
+                _hand_over(true);
+                _thread.join();
+                _file.close();
+                if (_error) std::rethrow_exception(_error);
+                return _bytes;
+            }
+
+        private:
+            struct _Candle{
+                Price open, high, low, close;
+                time_t time;
+                size_t levels;
+            };
+
+            struct _Batch{
+                std::vector<_Candle> candles;
+                std::vector<Level> levels;
+            };
+
+            static constexpr size_t _batch_size = 1 << 16; //Candles and levels of a batch before it is handed over
+            static constexpr size_t _chunk = 1 << 20; //Bytes of text per write
+
+            data::FileStream _file;
+            std::thread _thread;
+            std::mutex _mut;
+            std::condition_variable _cv;
+            _Batch _filling, _flushing;
+            std::atomic<bool> _busy = false; //The writer thread owns _flushing
+            bool _last = false;
+            std::exception_ptr _error;
+            size_t _bytes = 0;
+
+            //Hands the filled batch over to the writer thread, which should be idle
+            void _hand_over(bool last){
+                std::swap(_filling, _flushing);
+                {
+                    std::lock_guard<std::mutex> lock(_mut);
+                    _last = last;
+                    _busy.store(true);
+                }
+                _cv.notify_all();
+            }
+
+            //Same form as operator<< of a stream with the default precision i.e printf("%g")
+            static void _append(std::string &out, float x){
+                char buf[32];
+                out.append(buf, std::to_chars(buf, buf+sizeof(buf), x, std::chars_format::general, 6).ptr);
+            }
+
+            static void _append(std::string &out, long long x){
+                char buf[24];
+                out.append(buf, std::to_chars(buf, buf+sizeof(buf), x).ptr);
+            }
+
+            void _write(std::string &text){
+                _file.write(text.data(), text.size());
+                if (!_file) throw std::logic_error("cause = aggregate_store() : Failed to write the file\n");
+                _bytes += text.size();
+                text.clear();
+            }
+
+            void _loop(){
+                std::string text;
+                text.reserve(_chunk + (1 << 12));
+                while (true){
+                    bool last;
+                    {
+                        std::unique_lock<std::mutex> lock(_mut);
+                        _cv.wait(lock, [&](){return _busy.load();});
+                        last = _last;
+                    }
+                    try {
+                        if (!_error){
+                            const Level *level = _flushing.levels.data();
+                            for (const _Candle &c : _flushing.candles){
+                                _append(text, c.open), text += ' ', _append(text, c.high), text += ' ', _append(text, c.low), text += ' ';
+                                _append(text, c.close), text += ' ', _append(text, (long long) c.time), text += ' ';
+                                _append(text, (long long) c.levels);
+                                for (size_t i = 0; i < c.levels; i++, level++){
+                                    text += ' ', _append(text, level->price), text += ' ', _append(text, level->bids), text += ' ';
+                                    _append(text, level->asks);
+                                    if (text.size() >= _chunk) _write(text);
+                                }
+                                text += '\n';
+                                if (text.size() >= _chunk) _write(text);
+                            }
+                            if (last && !text.empty()) _write(text);
+                        }
+                    }
+                    catch (...) {
+                        _error = std::current_exception();
+                    }
+                    _flushing.candles.clear();
+                    _flushing.levels.clear();
+                    {
+                        std::lock_guard<std::mutex> lock(_mut);
+                        _busy.store(false);
+                    }
+                    _cv.notify_all();
+                    if (last) return;
+                }
+            }
+        };
+
+        /*@brief Reads rows with the data handler and pushes them to buffer. Sets done after the last row is pushed.
+        An exception of the data handler stops the reading and is stored in error, to be rethrown once the thread is joined
+        */
+        inline void __stream__(SafeQueue<RowData> &buffer, data::FileStream &file, RowData (*func) (data::FileStream &),
+                std::atomic<bool> &done, std::exception_ptr &error, [[maybe_unused]] Stats *stats){
+            ORDERFLOW_STAT(std::chrono::nanoseconds parse_time{0}, push_time{0}; size_t rows = 0;)
+            try {
+                while (!file.eof()){
+                    ORDERFLOW_STAT(auto t0 = std::chrono::steady_clock::now();)
+                    RowData &&da = func(file);
+                    if (file.fail()) break; // Nothing was read, the previous line was the last one
+                    ORDERFLOW_STAT(auto t1 = std::chrono::steady_clock::now();)
+                    buffer.push(da);
+                    ORDERFLOW_STAT(parse_time += t1-t0; push_time += std::chrono::steady_clock::now()-t1; rows++;)
+                }
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+            ORDERFLOW_STAT(if (stats){stats->parse_time = parse_time; stats->producer_stall = push_time; stats->rows_parsed += rows;})
+            done = true;
+        }
 
         inline size_t __tagg__(const std::string &path, RowData (*func) (data::FileStream &), const std::string &store_path, std::vector<CandleStick> &candles,
-                const Price price_level_interval, const int time_interval, const bool store, size_t skip = 0){
+                const Price price_level_interval, const int time_interval, const bool store, size_t skip = 0, Stats *stats = nullptr,
+                std::pmr::memory_resource *resource = std::pmr::get_default_resource()){
+            ORDERFLOW_STAT(auto start = std::chrono::steady_clock::now(); std::chrono::nanoseconds consumer_stall{0}, level_time{0}, write_time{0};
+                size_t high_water = 0, candles_emitted = 0;)
             data::FileStream file_in;
-            file_in.open_except(path, std::ios::in);
+            data::open_input(file_in, path);
             size_t no_of_lines = 1;
 
             while (skip-- > 0){
@@ -66,40 +282,55 @@ namespace aggregator{
 
             Price high, low, close, open;
             time_t timestamp, prev_time;
-            std::map<Price, Level, std::greater<Price>> footprint;
-            data::FileStream file_out;
+            Footprint footprint(resource);
+            std::optional<__Writer__> writer;
 
-            if (store) file_out.open_except(store_path, std::ios::out);
+            if (store) writer.emplace(store_path);
 
             RowData &&first = func(file_in);
-            high = low = open = first.price;
+            if (file_in.fail()){ // No rows
+                data::check_input(file_in);
+                if (store) writer->close();
+                return 0;
+            }
+            high = low = open = close = first.price;
             prev_time = timestamp = first.timestamp;
             __set_price_level__(footprint, first, price_level_interval);
+            ORDERFLOW_STAT(if (stats) stats->rows_parsed = 1;)
+
+            SafeQueue<RowData> buffer;
+            std::atomic<bool> done = false;
+            std::exception_ptr error;
+            std::thread worker(__stream__, std::ref(buffer), std::ref(file_in), func, std::ref(done), std::ref(error), stats);
 
-            SafeQueue<RowData> buffer;        
-            std::thread worker(data::thread_stream, std::ref(buffer), std::ref(file_in), func);
+            auto emit = [&](){
+                ORDERFLOW_STAT(auto t0 = std::chrono::steady_clock::now();)
+                if (store) writer->add(open, high, low, close, timestamp, footprint);
+                else candles.emplace_back(open, high, low, close, timestamp, footprint);
+                ORDERFLOW_STAT(write_time += std::chrono::steady_clock::now()-t0; candles_emitted++;)
+            };
             
             while (true){
-                if (file_in.eof() && buffer.empty()){
-                    if (store){
-                        __write__(file_out, open, high, low, close, timestamp, footprint);
+                if (buffer.empty()){
+                    if (done && buffer.empty()){ // done is checked first, so a row pushed before done was set is not missed
+                        emit();
+                        break;
                     }
-                    else candles.emplace_back(open, high, low, close, timestamp, footprint);
-                    break;
+                    ORDERFLOW_STAT(auto t0 = std::chrono::steady_clock::now(); while (buffer.empty() && !done); consumer_stall += std::chrono::steady_clock::now()-t0;)
+                    continue;
                 }
-                if (buffer.empty()) continue;
+                ORDERFLOW_STAT(high_water = std::max(high_water, buffer.size());)
                 const RowData &row = buffer.front();
 
                 if (!__within_interval__(prev_time, row.timestamp, time_interval)){
-                    if (store){
-                        __write__(file_out, open, high, low, close, timestamp, footprint);
-                    }
-                    else candles.emplace_back(open, high, low, close, timestamp, footprint);
-                    footprint = {};
+                    emit();
+                    footprint.clear();
                     low = open = high = row.price;
                     timestamp = row.timestamp;
                 }
+                ORDERFLOW_STAT(auto t0 = std::chrono::steady_clock::now();)
                 __set_price_level__(footprint, row, price_level_interval);
+                ORDERFLOW_STAT(level_time += std::chrono::steady_clock::now()-t0;)
                 high = (high > row.price) ? high : row.price;
                 low = (low < row.price) ? low  : row.price;
                 close = row.price;
@@ -108,6 +339,211 @@ namespace aggregator{
                 buffer.pop();
             }
             worker.join();
+            if (error) std::rethrow_exception(error);
+            data::check_input(file_in);
+            [[maybe_unused]] size_t bytes_written = store ? writer->close() : 0;
+            ORDERFLOW_STAT(if (stats){
+                std::error_code ec;
+                stats->bytes_read = std::filesystem::file_size(path, ec);
+                stats->bytes_written = bytes_written;
+                stats->queue_high_water = high_water;
+                stats->consumer_stall = consumer_stall;
+                stats->level_time = level_time;
+                stats->write_time = write_time;
+                stats->candles_emitted = candles_emitted;
+                stats->total_time = std::chrono::steady_clock::now()-start;
+            })
+            return no_of_lines;
+        }
+
+        /*@brief Merges next into prev if both candles are within the same time interval. Used to stitch a candle that spans two files.
+        @return true if the candles were merged
+        */
+        inline bool __stitch__(CandleStick &prev, CandleStick &next, const int time_interval){
+            if (!__within_interval__(prev.timestamp(), next.timestamp(), time_interval)) return false;
+            Footprint &footprint = prev.footprint();
+            for (auto &p : next.footprint()){
+                Level &x = footprint[p.first];
+                x.price = p.first;
+                x.bids += p.second.bids;
+                x.asks += p.second.asks;
+            }
+            prev = CandleStick(prev.open(), std::max(prev.high(), next.high()), std::min(prev.low(), next.low()), next.close(),
+                prev.timestamp(), footprint);
+            return true;
+        }
+
+        /*@brief Aggregates several files concurrently and emits the candles in the order of the files.
+        Each file is aggregated by a task of tasks::global(), while the calling thread stitches the candles at the file boundaries and
+        stores them. At most threads files are aggregated at the same time, and tasks never run more than 2*threads files ahead of the
+        calling thread, which bounds the memory used.
+        */
+        inline size_t __tagg_files__(const std::vector<std::string> &paths, RowData (*func) (data::FileStream &), const std::string &store_path,
+                std::vector<CandleStick> &candles, const Price price_level_interval, const int time_interval, const bool store, size_t skip,
+                unsigned threads){
+            const size_t n = paths.size();
+            if (n == 0) return 0;
+            if (threads == 0) threads = tasks::global().threads();
+            if (threads > n) threads = n;
+            const size_t window = 2*threads;
+
+            std::vector<std::vector<CandleStick>> results(n);
+            std::vector<size_t> lines(n, 0);
+            std::unique_ptr<std::atomic<bool>[]> ready(new std::atomic<bool>[n]);
+            for (size_t i = 0; i < n; i++) ready[i] = false;
+            tasks::TaskGroup group(tasks::global(), threads);
+            auto submit = [&](size_t i){
+                group.run([&, i](){
+                    lines[i] = __tagg__(paths[i], func, "", results[i], price_level_interval, time_interval, false, skip);
+                    ready[i] = true;
+                });
+            };
+            for (size_t i = 0; i < std::min(n, window); i++) submit(i);
+
+            std::optional<__Writer__> writer;
+            size_t no_of_lines = 0;
+            CandleStick pending;
+            bool has_pending = false;
+            auto emit = [&](CandleStick &c){
+                if (store) writer->add(c);
+                else candles.push_back(std::move(c));
+            };
+
+            try {
+                if (store) writer.emplace(store_path);
+                for (size_t i = 0; i < n; i++){
+                    if (!group.wait_until([&](){return ready[i].load();})) break;
+                    std::vector<CandleStick> part = std::move(results[i]);
+                    if (i+window < n) submit(i+window);
+                    no_of_lines += lines[i];
+                    for (CandleStick &c : part){
+                        if (has_pending && __stitch__(pending, c, time_interval)) continue;
+                        if (has_pending) emit(pending);
+                        pending = std::move(c);
+                        has_pending = true;
+                    }
+                }
+                group.wait(); // Rethrows the exception of a file
+                if (has_pending) emit(pending);
+                if (store) writer->close();
+            }
+            catch (...) {
+                group.cancel();
+                throw;
+            }
+            return no_of_lines;
+        }
+
+        /*Candle being built from the rows of one feed*/
+        struct __Bar__{
+            Price open = 0, high = 0, low = 0, close = 0;
+            Footprint footprint;
+            bool empty = true;
+
+            void add(const RowData &row, const Price &price_interval){
+                if (empty) open = high = low = row.price;
+                __set_price_level__(footprint, row, price_interval);
+                high = (high > row.price) ? high : row.price;
+                low = (low < row.price) ? low : row.price;
+                close = row.price;
+                empty = false;
+            }
+
+            /*@return the candle. A feed without trades in the interval gets a flat candle at its last close and no footprint*/
+            CandleStick take(time_t timestamp){
+                if (empty) return CandleStick(close, close, close, close, timestamp);
+                CandleStick c(open, high, low, close, timestamp, footprint);
+                footprint = {};
+                empty = true;
+                return c;
+            }
+        };
+
+        /*@brief Aggregates several feeds into one footprint. Each feed is parsed on its own thread, and the rows are merged by timestamp
+        with a heap based k-way merge. Rows with the same timestamp are taken in the order of the feeds.
+        @param per_feed if not null, it is filled with one vector of candles per feed, aligned with the merged candles
+        */
+        inline size_t __tagg_merged__(const std::vector<Feed> &feeds, const std::string &store_path, std::vector<CandleStick> &candles,
+                std::vector<std::vector<CandleStick>> *per_feed, const Price price_level_interval, const int time_interval, const bool store){
+            const size_t k = feeds.size();
+            if (k == 0) return 0;
+            std::vector<data::FileStream> files(k);
+            std::vector<SafeQueue<RowData>> buffers(k);
+            std::unique_ptr<std::atomic<bool>[]> done(new std::atomic<bool>[k]);
+            std::vector<std::exception_ptr> errors(k);
+            std::vector<std::thread> workers;
+
+            for (size_t i = 0; i < k; i++){
+                data::open_input(files[i], feeds[i].path);
+                size_t skip = feeds[i].skip;
+                while (skip-- > 0){
+                    std::string _;
+                    getline(files[i], _);
+                }
+                done[i] = false;
+            }
+            // Opened before the readers start, so a store file that can't be opened doesn't leave threads to join
+            std::optional<__Writer__> writer;
+            if (store) writer.emplace(store_path);
+            for (size_t i = 0; i < k; i++)
+                workers.emplace_back([&, i](){
+                    try {
+                        data::thread_stream(buffers[i], files[i], feeds[i].handler);
+                    }
+                    catch (...) {
+                        errors[i] = std::current_exception(); // Rethrown once the readers are joined
+                    }
+                    done[i] = true; // Set after the last row is pushed, unlike eof()
+                });
+
+            // Waits for the next row of feed i. @return false if the feed has no more rows
+            auto wait_row = [&](size_t i){
+                while (buffers[i].empty()){
+                    if (done[i] && buffers[i].empty()) return false;
+                    std::this_thread::yield();
+                }
+                return true;
+            };
+
+            using Head = std::pair<time_t, size_t>; // (timestamp, feed)
+            std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heap;
+            for (size_t i = 0; i < k; i++)
+                if (wait_row(i)) heap.emplace(buffers[i].front().timestamp, i);
+
+            if (per_feed) per_feed->assign(k, {});
+
+            __Bar__ bar;
+            std::vector<__Bar__> bars(per_feed ? k : 0);
+            time_t timestamp = 0, prev_time = 0;
+            size_t no_of_lines = 0;
+
+            auto emit = [&](){
+                CandleStick c = bar.take(timestamp);
+                if (store) writer->add(c);
+                else candles.push_back(std::move(c));
+                for (size_t i = 0; i < bars.size(); i++) (*per_feed)[i].push_back(bars[i].take(timestamp));
+            };
+
+            while (!heap.empty()){
+                size_t i = heap.top().second;
+                heap.pop();
+                RowData row = buffers[i].front();
+                buffers[i].pop();
+
+                if (no_of_lines > 0 && !__within_interval__(prev_time, row.timestamp, time_interval)) emit();
+                if (bar.empty) timestamp = row.timestamp;
+                bar.add(row, price_level_interval);
+                if (per_feed) bars[i].add(row, price_level_interval);
+                prev_time = row.timestamp;
+                no_of_lines++;
+
+                if (wait_row(i)) heap.emplace(buffers[i].front().timestamp, i);
+            }
+            if (no_of_lines > 0) emit();
+            for (auto &w : workers) w.join();
+            for (auto &e : errors) if (e) std::rethrow_exception(e);
+            for (auto &file : files) data::check_input(file);
+            if (store) writer->close();
             return no_of_lines;
         }
 
@@ -131,6 +567,33 @@ namespace aggregator{
         return __tagg__(path,  handler, "", candles, price_level_interval, time_interval, false, skip);        
     }
 
+    /*@brief Aggregates the data and adds the candlesticks to chart. The footprints are allocated from the arena of the chart, so
+    aggregating and destroying millions of levels costs a few large allocations. See Chart::resource()
+
+    @param path location of the file to be read from
+    @param handler data handler. Basically a function that parses a line of csv and returns RowData.
+    @param chart chart that will contain the candlesticks
+    @param price_level_interval the price difference between each price level. It determines each price level of the footprint
+    @param time_interval time interval (in seconds)
+    @param skip number of lines to skip. Sometimes the first few lines are not data but other information e.g column names
+    @return number of lines read
+    */
+    inline size_t aggregate(const std::string &path,  RowData (*handler) (data::FileStream &), Chart &chart,
+            const Price price_level_interval, const int time_interval, size_t skip = 0){
+
+        return __tagg__(path,  handler, "", chart.candles(), price_level_interval, time_interval, false, skip, nullptr, chart.resource());
+    }
+
+    /*@brief Same as aggregate(), and fills stats with the counters and timers of the pipeline. See Stats
+    @note stats is only filled when compiled with ORDERFLOW_STATS defined
+    */
+    inline size_t aggregate(const std::string &path,  RowData (*handler) (data::FileStream &), std::vector<CandleStick> &candles,
+            const Price price_level_interval, const int time_interval, size_t skip, Stats &stats){
+
+        stats = {};
+        return __tagg__(path,  handler, "", candles, price_level_interval, time_interval, false, skip, &stats);
+    }
+
     /*@brief Aggregates the data and stores it in the location of store_path.
     
     @param path location of the file
@@ -147,4 +610,151 @@ namespace aggregator{
         std::vector<CandleStick> candles;
         return __tagg__(path, handler, store_path, candles, price_level_interval, time_interval, true, skip);
     }
+
+    /*@brief Same as aggregate_store(), and fills stats with the counters and timers of the pipeline. See Stats
+    @note stats is only filled when compiled with ORDERFLOW_STATS defined
+    */
+    inline size_t aggregate_store(const std::string &path,  RowData (*handler) (data::FileStream &), const std::string &store_path,
+            const Price price_level_interval, const int time_interval, size_t skip, Stats &stats){
+
+        std::vector<CandleStick> candles;
+        stats = {};
+        return __tagg__(path, handler, store_path, candles, price_level_interval, time_interval, true, skip, &stats);
+    }
+
+    /*@brief Aggregates several files concurrently and fills the candles parameter with the candlesticks in the order of the files.
+    A candle that spans two consecutive files is stitched into one candle.
+
+    @param paths location of the files, in time order. See data::glob()
+    @param handler data handler. Basically a function that parses a line of csv and returns RowData. @note It should be thread safe
+    @param candles vector that will contain the candlesticks
+    @param price_level_interval the price difference between each price level. It determines each price level of the footprint
+    @param time_interval time interval (in seconds)
+    @param skip number of lines to skip at the start of each file.
+    @param threads number of files aggregated at the same time. 0 uses the number of threads of tasks::global()
+    @return number of lines read
+    */
+    inline size_t aggregate_files(const std::vector<std::string> &paths,  RowData (*handler) (data::FileStream &), std::vector<CandleStick> &candles,
+            const Price price_level_interval, const int time_interval, size_t skip = 0, unsigned threads = 0){
+
+        return __tagg_files__(paths, handler, "", candles, price_level_interval, time_interval, false, skip, threads);
+    }
+
+    /*@brief Aggregates several files concurrently and stores the candlesticks in the location of store_path, in the order of the files.
+    A candle that spans two consecutive files is stitched into one candle.
+
+    @param paths location of the files, in time order. See data::glob()
+    @param handler data handler. Basically a function that parses a line of csv and returns RowData. @note It should be thread safe
+    @param store_path location of the text file that will contain the aggregated data
+    @param price_level_interval the price difference between each price level. It determines each price level of the footprint
+    @param time_interval time interval (in seconds)
+    @param skip number of lines to skip at the start of each file.
+    @param threads number of files aggregated at the same time. 0 uses the number of threads of tasks::global()
+    @return number of lines read
+    */
+    inline size_t aggregate_store_files(const std::vector<std::string> &paths,  RowData (*handler) (data::FileStream &), const std::string &store_path,
+            const Price price_level_interval, const int time_interval, size_t skip = 0, unsigned threads = 0){
+
+        std::vector<CandleStick> candles;
+        return __tagg_files__(paths, handler, store_path, candles, price_level_interval, time_interval, true, skip, threads);
+    }
+
+    /*@brief Aggregates several feeds of the same asset (e.g spot and perpetual, or several exchanges) into one footprint.
+    The rows of the feeds are merged by timestamp, each feed is parsed on its own thread.
+
+    @param feeds sources of the data. Each file should be in time order
+    @param candles vector that will contain the merged candlesticks
+    @param price_level_interval the price difference between each price level. It determines each price level of the footprint
+    @param time_interval time interval (in seconds)
+    @param per_feed if not null, it is filled with the candles of each feed, so the bid/ask of each venue is kept. per_feed[i][j]
+    contains the trades of feeds[i] in candles[j]; it is a flat candle without footprint if feeds[i] has no trade in candles[j]
+    @return number of lines read
+    */
+    inline size_t aggregate_merged(const std::vector<Feed> &feeds, std::vector<CandleStick> &candles, const Price price_level_interval,
+            const int time_interval, std::vector<std::vector<CandleStick>> *per_feed = nullptr){
+
+        return __tagg_merged__(feeds, "", candles, per_feed, price_level_interval, time_interval, false);
+    }
+
+    /*@brief Aggregates several feeds of the same asset (e.g spot and perpetual, or several exchanges) into one footprint and stores it
+    in the location of store_path. The rows of the feeds are merged by timestamp, each feed is parsed on its own thread.
+
+    @param feeds sources of the data. Each file should be in time order
+    @param store_path location of the text file that will contain the aggregated data
+    @param price_level_interval the price difference between each price level. It determines each price level of the footprint
+    @param time_interval time interval (in seconds)
+    @return number of lines read
+    */
+    inline size_t aggregate_store_merged(const std::vector<Feed> &feeds, const std::string &store_path, const Price price_level_interval,
+            const int time_interval){
+
+        std::vector<CandleStick> candles;
+        return __tagg_merged__(feeds, store_path, candles, nullptr, price_level_interval, time_interval, true);
+    }
+
+    /*Aggregates rows one at a time into the candles of a chart, e.g trades received live. It gives the same candles as aggregate().
+    A candle is added to the chart when the first row of the next interval arrives, or by flush().
+    @param chart chart the candles are added to. The footprints are allocated from its arena, so adding a row doesn't allocate
+    except for the first row at a new price and the arena growing
+    @param price_level_interval the price difference between each price level
+    @param time_interval time interval (in seconds)
+    */
+    class Builder{
+    public:
+        Builder(Chart &chart, const Price price_level_interval, const int time_interval) : _chart(chart),
+        _price_interval(price_level_interval), _time_interval(time_interval), _footprint(chart.resource()){}
+
+        /*Adds a row
+        @return true if the row is the first of a new interval, the previous candle was added to the chart
+        */
+        bool add(const RowData &row){
+            bool closed = false;
+            if (!_empty && !__within_interval__(_prev_time, row.timestamp, _time_interval)){
+                flush();
+                closed = true;
+            }
+            if (_empty){
+                _open = _high = _low = row.price;
+                _timestamp = row.timestamp;
+                _empty = false;
+            }
+            __set_price_level__(_footprint, row, _price_interval);
+            _high = (_high > row.price) ? _high : row.price;
+            _low = (_low < row.price) ? _low : row.price;
+            _close = row.price;
+            _prev_time = row.timestamp;
+            return closed;
+        }
+
+        /*Adds the candle being built to the chart, e.g at the end of the data
+        @return false if no candle was being built
+        */
+        bool flush(){
+            if (_empty) return false;
+            _chart.push_back(CandleStick(_open, _high, _low, _close, _timestamp, _footprint));
+            _footprint.clear();
+            _empty = true;
+            return true;
+        }
+
+        //@return true if no candle is being built
+        bool empty() const {return _empty;}
+
+        //@return candle being built. Its footprint is moved into the chart when the candle is added
+        Price open() const {return _open;}
+        Price high() const {return _high;}
+        Price low() const {return _low;}
+        Price close() const {return _close;}
+        time_t timestamp() const {return _timestamp;}
+        const Footprint &footprint() const {return _footprint;}
+
+    private:
+        Chart &_chart;
+        Price _price_interval;
+        int _time_interval;
+        Footprint _footprint;
+        Price _open = 0, _high = 0, _low = 0, _close = 0;
+        time_t _timestamp = 0, _prev_time = 0;
+        bool _empty = true;
+    };
 }
@@ -1,7 +1,9 @@
 /*
 This file is contains necessary code to successfully backtest a strategy
 
-BackTest = a class that contains 'properties' to simulate live market and test a strategy
+BasicBackTest = a class that contains 'properties' to simulate live market and test a strategy
+BackTest = BasicBackTest using a function as the strategy
+Timeframe = candles of another chart (e.g a higher timeframe) that are closed at the current candle of a backtest
 */
 
 #pragma once
@@ -9,15 +11,82 @@ BackTest = a class that contains 'properties' to simulate live market and test a
 #include "candlestick.hpp"
 #include "chart.hpp"
 #include "order.hpp"
-#include <queue>
+#include "histogram.hpp"
+#include "book.hpp"
+#include "scheduler.hpp"
 #include <utility>
 #include <chrono>
+#include <iomanip>
+#include <concepts>
+#include <type_traits>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <functional>
+
+/*Orders computed for every candle up front, used by the vectorized mode of the backtest engine (BasicBackTest::run(const Signals &)).
+Column i holds the order the strategy would add on candle i. All the columns should have one value per candle
+@param n number of candles
+*/
+struct Signals{
+    std::vector<int8_t> direction; //1 = buy, -1 = sell, 0 = no order on the candle
+    std::vector<Price> entry; //Entry price. Ignored for market orders, which are filled at the close, but still checked against sl and tp
+    std::vector<Price> sl; //Stop loss
+    std::vector<Price> tp; //Take profit
+    OrderType order_type = OrderType::market_order; //Type of every order
+    size_t cancel_after = SIZE_MAX; //Maximum number of candles before cancelling a limit order. See Order::cancel_after
+
+    Signals() = default;
+
+    Signals(size_t n) : direction(n, 0), entry(n, 0), sl(n, 0), tp(n, 0){}
+};
+
+/*Candles of a chart that are closed at the current candle of a backtest, most recent first: [0] is the last closed candle, [1] the one
+before it. See BasicBackTest::htf()
+@note Valid until the engine moves to the next candle
+*/
+class Timeframe{
+public:
+    Timeframe(std::vector<CandleStick> &candles, size_t closed) : _candles(&candles), _closed(closed){}
+
+    //@return the k-th last closed candle. k should be less than size()
+    CandleStick &operator[](size_t k) const {return (*_candles)[_closed-1-k];}
+
+    //@return number of closed candles
+    size_t size() const {return _closed;}
+
+    bool empty() const {return _closed == 0;}
+
+    //@return index of the last closed candle in its chart, e.g to read the indicators of the chart. SIZE_MAX if empty
+    size_t index() const {return _closed-1;}
+
+private:
+    std::vector<CandleStick> *_candles;
+    size_t _closed;
+};
+
+/*Tag for a strategy that is a function pointer. It is the strategy type of BackTest*/
+struct FunctionStrategy{};
+
+template <typename Strategy = FunctionStrategy>
+class BasicBackTest;
+
+/*A strategy is either callable with the engine, or an object with an on_candle(engine) member function. It can also have an
+on_start(engine) member function, called at the start of every run e.g to reset its state*/
+template <typename Strategy, typename Engine>
+concept CandleStrategy = std::invocable<Strategy &, Engine &> || requires(Strategy &s, Engine &engine){ s.on_candle(engine); };
 
 /*An object that backtest a strategy on a given data
 @param chart chart containing the candlesticks to be backtested
-@param strategy function containing strategy to be backtested
+@param strategy strategy to be backtested. Called on every candle
+@param strat_name name of the strategy
+@tparam Strategy type of the strategy. The strategy is resolved at compile time, so the call on every candle can be inlined, and
+it is stored in the engine so it can keep its own state (which makes it safe to run several engines on different threads).
+Defaults to FunctionStrategy i.e a function pointer void (*)(BackTest &). See CandleStrategy
 */
-class BackTest{
+template <typename Strategy>
+class BasicBackTest{
 
     struct PerformanceMetric{
         size_t long_wins; //Number of profitable longs/buys
@@ -33,43 +102,197 @@ class BackTest{
         the profit/loss over the backtest.
         */
         float risk_reward = 0;
-
-        float max_dd = 0; // Maximum drawdown
-        Quantity initial_equity = 10'000; //Starting equity. i.e equity at the start
-        Quantity equity = initial_equity; //Current equity
-        Quantity max_equity = initial_equity; //Peak equity during the entire simulation
-        
-        /*Longest duration of a drawdown. There could be multiple drawdown in a simulation, it measures the longest drawdown.
-         @note It is unrelated to max drawdown*/
-        long long max_dd_duration = 0; 
-        
-        long long dd_duration = 0; //Current drawdown duration. 0 if it is not in a drawdown
         float returns = 0; //Current returns
     };
 
+    /*Breakdown of the time spent by the engine. Only filled when BackTest::profile is true*/
+    struct Profiling{
+        std::chrono::nanoseconds manage_trades{0}; //Time spent checking if open trades hit their stop loss or take profit
+        std::chrono::nanoseconds manage_orders{0}; //Time spent filling and cancelling limit orders
+        std::chrono::nanoseconds strategy{0}; //Time spent in the strategy
+        std::chrono::nanoseconds update_dd{0}; //Time spent updating the drawdown
+        LatencyHistogram strategy_latency; //Time spent in the strategy on each candle
+        size_t peak_open_trades = 0; //Maximum number of trades open at the same time
+        size_t peak_pending_orders = 0; //Maximum number of limit orders waiting to be filled at the same time
+    };
+
 public:
     float risk = 0.01; //Risk per trade. It is not in percentage i.e 1% should be 0.01. @note Should not be negative
+    /*Measures the time spent in each part of the engine and in the strategy. See print_stat() and export_profile().
+    @note It adds a few timer reads per candle*/
+    bool profile = false;
+    /*Called with every order accepted by add_order(), after its entry_id is set, e.g to send the orders of a live strategy to a broker.
+    Empty by default*/
+    std::function<void (const Order &)> order_sink;
 
-    BackTest(Chart &chart, void (*strategy) (BackTest &), const char *strat_name = "") : _candles(_chart.candles()){
+    //Type of the strategy stored in the engine
+    using strategy_type = std::conditional_t<std::is_same_v<Strategy, FunctionStrategy>, void (*) (BasicBackTest &), Strategy>;
+
+    BasicBackTest(Chart &chart, strategy_type strategy, const char *strat_name = "") : _candles(_chart.candles()), _strategy(std::move(strategy)), _book(_candles){
+        static_assert(CandleStrategy<strategy_type, BasicBackTest>, "Strategy should be callable with the engine or have on_candle(engine)");
         _chart = chart;
-        _strategy = strategy;
         _strategy_name = strat_name;
     }
 
+    /*The engine refers to its own copy of the chart, so it can't be copied or moved. Construct engines in place e.g in a std::deque or a
+    std::unique_ptr*/
+    BasicBackTest(const BasicBackTest &) = delete;
+    BasicBackTest &operator=(const BasicBackTest &) = delete;
+
     /*Runs the backtest on the strategy*/
     void run(){
         auto start = std::chrono::high_resolution_clock::now();
         _reset();
-        for (; _index < _candles.size(); ++_index){
-            _manage_trades();
-            _manage_orders();
-            _strategy(*this);
-            _update_dd();
+        _account.curve.reserve(_candles.size());
+        _on_start();
+        if (profile) _run_profiled();
+        else {
+            for (; _index < _candles.size(); ++_index){
+                _manage_trades();
+                _manage_orders();
+                _on_candle();
+                _update_dd();
+            }
         }
         _run_analysis();
         _metric.time_taken = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now()-start);
     }
     
+    /*Runs the backtest on signals computed up front, e.g as columns from indicators, instead of calling the strategy on every candle.
+    The signals are checked in one pass over the columns, fills and exits are found with range queries over the candles (see RangeIndex)
+    and ordered with counting sorts by candle. The trades and metrics are the same as run() with a strategy adding the order of each
+    signal on its candle, and it takes about the same time: both spend most of it in the range queries and the equity of each candle.
+    @param signals orders of every candle. The tag of each trade is the index of its signal
+    @note The strategy is not called and profile is ignored
+    */
+    void run(const Signals &signals){
+        auto start = std::chrono::high_resolution_clock::now();
+        const size_t n = _candles.size();
+        if (signals.direction.size() != n || signals.entry.size() != n || signals.sl.size() != n || signals.tp.size() != n)
+            throw std::logic_error("cause = run() : Signals should have one value per candle\n");
+        _reset();
+        _account.curve.reserve(n);
+        const RangeIndex &range = _book.range();
+        const bool limit = signals.order_type == OrderType::limit;
+        _Batch &b = _batch;
+        b.fills.clear();
+        b.offsets.assign(n+1, 0);
+
+        // Fill of each proper signal (see Book::check()). All the orders have the same type, so a market order is the only fill of its
+        // candle and limit fills of a candle are buys from the highest entry, then sells from the lowest
+        for (size_t i = 0; i < n; i++){
+            const int8_t d = signals.direction[i];
+            if (d == 0) continue;
+            const Price entry = signals.entry[i], sl = signals.sl[i], tp = signals.tp[i];
+            if (d > 0 ? (entry <= sl || tp <= entry) : (entry >= sl || tp >= entry)) continue;
+            size_t k = i;
+            if (limit){
+                const Price close = _candles[i].close();
+                if (d > 0 ? entry > close : entry < close) continue;
+                size_t last = signals.cancel_after < n-i-1 ? i+signals.cancel_after+1 : n;
+                if (d > 0) k = range.first_low_below(i+1, std::nextafter(entry, std::numeric_limits<Price>::infinity())); // low <= entry
+                else k = range.first_high_above(i+1, std::nextafter(entry, -std::numeric_limits<Price>::infinity())); // high >= entry
+                if (k >= last) continue;
+            }
+            b.fills.push_back(_Fill{k, d > 0 ? 0 : 1, d > 0 ? -entry : entry, i, limit ? entry : _candles[i].close()});
+            b.offsets[k+1]++;
+        }
+
+        // Counting sort of the fills by candle. Signals are visited in order so each candle keeps them by signal, only candles with
+        // several limit fills are sorted
+        for (size_t k = 0; k < n; k++) b.offsets[k+1] += b.offsets[k];
+        b.sorted.resize(b.fills.size());
+        b.cursor.assign(b.offsets.begin(), b.offsets.end()-1);
+        for (const _Fill &f : b.fills) b.sorted[b.cursor[f.index]++] = f;
+        if (limit){
+            for (size_t k = 0; k < n; k++){
+                if (b.offsets[k+1]-b.offsets[k] < 2) continue;
+                std::sort(b.sorted.begin()+b.offsets[k], b.sorted.begin()+b.offsets[k+1], [](const _Fill &l, const _Fill &r){
+                    if (l.group != r.group) return l.group < r.group;
+                    if (l.key != r.key) return l.key < r.key;
+                    return l.signal < r.signal;
+                });
+            }
+        }
+
+        // Exit of each trade, from the candle after the fill. The stop loss is checked first
+        b.exits.clear();
+        b.exit_offsets.assign(n+1, 0);
+        b.opened.assign(n+1, 0);
+        for (const _Fill &f : b.sorted){
+            const size_t s = f.signal;
+            Trade tr{};
+            tr.entry = f.entry;
+            tr.sl = signals.sl[s];
+            tr.tp = signals.tp[s];
+            tr.timestamp = _candles[f.index].timestamp();
+            tr.direction = signals.direction[s] > 0 ? Direction::buy : Direction::sell;
+            tr.tag = s;
+            bool success;
+            size_t exit = _book.find_exit(tr, f.index, success);
+            if (exit < n){
+                tr.trade_completed = true;
+                tr.success = success;
+                if (!tr.success) tr.rr = -1;
+                else if (tr.direction == Direction::buy) tr.rr = (tr.tp-tr.entry)/ (tr.entry-tr.sl);
+                else tr.rr = (tr.entry-tr.tp)/ (tr.sl-tr.entry);
+                b.exits.emplace_back(exit, _book.trades().size());
+                b.exit_offsets[exit+1]++;
+            }
+            b.opened[f.index]++;
+            b.opened[exit]--;
+            _book.add_trade(tr);
+        }
+
+        // Counting sort of the exits by candle, trades of a candle stay in the order they were taken
+        for (size_t k = 0; k < n; k++) b.exit_offsets[k+1] += b.exit_offsets[k];
+        b.exit_trades.resize(b.exits.size());
+        b.cursor.assign(b.exit_offsets.begin(), b.exit_offsets.end()-1);
+        for (const auto &[exit, trade] : b.exits) b.exit_trades[b.cursor[exit]++] = trade;
+
+        // Equity, in the order the engine applies it: by exit candle, then by trade
+        int open = 0;
+        for (_index = 0; _index < n; _index++){
+            for (size_t e = b.exit_offsets[_index]; e < b.exit_offsets[_index+1]; e++) _account.apply(_book.trades()[b.exit_trades[e]], risk);
+            open += b.opened[_index];
+            _account.end_step(open > 0);
+        }
+        _run_analysis();
+        _metric.time_taken = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now()-start);
+    }
+
+    /*Starts a run made one candle at a time with step(), e.g on a chart that grows while the strategy runs (see live.hpp). Resets the
+    engine and calls on_start*/
+    void start(){
+        _reset();
+        _on_start();
+    }
+
+    /*Runs the strategy on the next candle of the chart. The chart can grow between calls
+    @return false if the strategy has run on every candle of the chart
+    */
+    bool step(){
+        if (_next >= _candles.size()) return false;
+        _index = _next++;
+        for (_Timeframe &tf : _timeframes) _align(tf);
+        _manage_trades();
+        _manage_orders();
+        _on_candle();
+        _update_dd();
+        return true;
+    }
+
+    //@return number of candles run by step() since start()
+    size_t steps() const {return _next;}
+
+    /*Computes the statistics of a run made with step(), e.g before print_stat(). Can be called at any time during the run*/
+    void finish(){
+        auto time_taken = _metric.time_taken;
+        _metric = {};
+        _metric.time_taken = time_taken;
+        _run_analysis();
+    }
+
     // @return Index of the current candle during backtest
     size_t index() const {return _index;}
     
@@ -78,6 +301,40 @@ public:
     
     //@return chart
     Chart &chart() {return _chart;}
+
+    //@return the strategy e.g to read the state of a strategy object after a run
+    strategy_type &strategy() {return _strategy;}
+
+    /*Adds a chart of another timeframe, e.g 1h candles for a strategy running on 1m candles. The index of the last closed candle of the
+    timeframe is computed once for every candle of the backtest, so htf() is a lookup. A candle of the timeframe is closed at a candle of
+    the backtest when the next candle of the timeframe has started by the close of that candle, i.e before the first trade of the next
+    candle of the backtest. Both charts should be aggregated from the same trades, the timeframe being a multiple of the interval of the
+    backtest, so no candle of the timeframe is seen before all of its trades are. The last candle of the chart has no next candle, it
+    only sees the candles of the timeframe followed by a candle started by its own open, e.g during a live run the candle that closes an
+    hour sees it on the next candle.
+    @param chart chart of the timeframe. It is not copied and should outlive the engine. Candles can be added to both charts between
+    runs and during a run made with step()
+    @return id of the timeframe, starting at 1. Id 0 is the chart of the backtest
+    */
+    size_t add_timeframe(Chart &chart){
+        _timeframes.push_back(_Timeframe{&chart, {}, 0});
+        _align(_timeframes.back());
+        return _timeframes.size();
+    }
+
+    /*@return candles of a timeframe closed at the current candle, e.g in a strategy
+    CandleStick &hour = self.htf(1)[0]; // last closed 1h candle
+    Timeframe 0 is the chart of the backtest, its candle [0] is the current candle
+    @param id id returned by add_timeframe()
+    */
+    Timeframe htf(size_t id){
+        if (id == 0) return Timeframe(_candles, _index+1);
+        _Timeframe &tf = _timeframes[id-1];
+        return Timeframe(tf.chart->candles(), tf.closed[_index]);
+    }
+
+    //@return number of timeframes added with add_timeframe()
+    size_t timeframes() const {return _timeframes.size();}
     
     //@return Returns of the strategy @note Not in percentage
     float returns() const {return _metric.returns;}
@@ -86,26 +343,50 @@ public:
     float winrate() const {return ((float) (_metric.short_wins+_metric.long_wins))/_metric.n_trades;}
     
     //@return The maximum drawdown @note Not in percentage
-    float max_dd() const {return _metric.max_dd;}
+    float max_dd() const {return _account.max_dd;}
     
     //@return A const reference to the trades taken
     const std::vector<Trade> &trades() const {
-        return _trades;
+        return _book.trades();
+    }
+
+    /*@return Sharpe ratio of the returns per candle. 0 if it is undefined
+    @param periods number of candles in the period it is scaled to e.g 365 for daily candles scaled to a year. 1 means per candle
+    */
+    double sharpe(double periods = 1) const {return _account.sharpe(periods);}
+
+    /*@return Sortino ratio of the returns per candle. 0 if it is undefined
+    @param periods number of candles in the period it is scaled to. 1 means per candle
+    */
+    double sortino(double periods = 1) const {return _account.sortino(periods);}
+
+    //@return returns over the absolute maximum drawdown. 0 if there was no drawdown
+    double calmar() const {return _account.calmar();}
+
+    //@return gross profit over gross loss. 0 if there was no loss
+    double profit_factor() const {return _account.profit_factor();}
+
+    //@return average reward to risk of a trade
+    double expectancy() const {return _account.expectancy();}
+
+    //@return fraction of the candles that closed with a trade open @note Not in percentage
+    double exposure() const {return _account.exposure();}
+
+    //@return equity and drawdown at the close of each candle
+    const std::vector<EquityPoint> &equity_curve() const {return _account.curve;}
+
+    /*Writes the equity curve of the last run. See Account::write_curve()
+    @param file_path path of the file. A .csv file is written as text, any other file in binary form
+    */
+    void export_equity(const char *file_path) const {
+        _account.write_curve(file_path, [this](size_t i){return _candles[i].timestamp();});
     }
 
     /*Adds an order to the backtest engine
     @note every order should have a stop loss and take profit
     */
     void add_order(Order &order){
-        if (_check(order)){
-            order.entry_id = _index;
-            if (order.order_type == OrderType::market_order){
-                order.entry = _candles[_index].close();
-                _fill(order);
-            }
-            else if (order.direction == Direction::buy) _buy_limit.push(order);
-            else _sell_limit.push(order);
-        }
+        if (_book.add_order(order, _index) && order_sink) order_sink(order);
     }
     
     /*Adds an order to the backtest engine
@@ -127,21 +408,47 @@ public:
         << "winrate : " << ((_metric.n_trades > 0 ? (float) (_metric.short_wins+_metric.long_wins)/_metric.n_trades : 0) *100)
         << "%\tnumber of trades : " 
         << _metric.n_trades << "\nmax loss in a row : " << _metric.max_loss_in_a_row  << "\tmax win in a row : " << _metric.max_win_in_a_row 
-        <<"\nmax drawdown : " << _metric.max_dd*100  << "%\tmax drawdown (duration) : " << _metric.max_dd_duration << " candles"
+        <<"\nmax drawdown : " << _account.max_dd*100  << "%\tmax drawdown (duration) : " << _account.max_dd_duration << " candles"
         << "\nlongs : " << _metric.longs << "\t\tshorts : " << _metric.shorts 
         << "\nlongs winrate : " << ((_metric.longs > 0? ((float) _metric.long_wins)/ _metric.longs : 0)*100) << "%\tshorts winrate : " 
         << (_metric.shorts > 0 ? ((float) _metric.short_wins)/ _metric.shorts : 0) *100
         << "%\nsignal rate : " << (_candles.size() > 0 ? ((float)_metric.n_trades)/ _candles.size() : 0)*100 << "%\treturns : " 
         << _metric.returns*100 << "%\n" << "time taken : " << _metric.time_taken.count() << " ms\tnumber of candles : " << _candles.size()
-        << "\n";
+        << "\nsharpe : " << sharpe() << "\tsortino : " << sortino() << "\tcalmar : " << calmar()
+        << "\nprofit factor : " << profit_factor() << "\texpectancy : " << expectancy() << " R\texposure : " << exposure()*100 << "%\n";
+        if (profile){
+            auto ms = [](std::chrono::nanoseconds x){return x.count()/1e6;};
+            std::cout << "manage trades : " << ms(_profiling.manage_trades) << " ms\tmanage orders : " << ms(_profiling.manage_orders)
+            << " ms\tstrategy : " << ms(_profiling.strategy) << " ms\tupdate drawdown : " << ms(_profiling.update_dd) << " ms\n"
+            << "peak open trades : " << _profiling.peak_open_trades << "\tpeak pending orders : " << _profiling.peak_pending_orders << "\n"
+            << "strategy latency per candle : " << _profiling.strategy_latency << "\n";
+        }
         std::cout.copyfmt(cout_state);
     }
+
+    /*Writes the profiling breakdown of the last run as JSON. Times are in nanoseconds
+    @param file_path path of the JSON file
+    @note profile should be true during the run
+    */
+    void export_profile(const char *file_path){
+        std::ofstream file(file_path);
+        if (!file) throw std::logic_error("cause = export_profile() : File not opened\n");
+        file << "{\"strategy_name\": \"" << _strategy_name << "\", \"candles\": " << _candles.size()
+        << ", \"time_taken_ns\": " << std::chrono::duration_cast<std::chrono::nanoseconds>(_metric.time_taken).count()
+        << ", \"manage_trades_ns\": " << _profiling.manage_trades.count() << ", \"manage_orders_ns\": " << _profiling.manage_orders.count()
+        << ", \"strategy_ns\": " << _profiling.strategy.count() << ", \"update_dd_ns\": " << _profiling.update_dd.count()
+        << ", \"peak_open_trades\": " << _profiling.peak_open_trades << ", \"peak_pending_orders\": " << _profiling.peak_pending_orders
+        << ", \"strategy_latency\": " << _profiling.strategy_latency.json() << "}\n";
+    }
+
+    //@return profiling breakdown of the last run @note profile should be true during the run
+    const Profiling &profiling() const {return _profiling;}
     
     /*Prints the time, direction and the trades success to the console*/
     void print_trades(){
         std::tm ti;
         time_t temp;
-        for (auto &tr : _trades){
+        for (auto &tr : _book.trades()){
             temp = tr.timestamp/1000;
             localtime_s(&ti, &temp);
             std::cout << ti.tm_year+1900 << "/" << ti.tm_mon+1 << "/" << ti.tm_mday << " " << ti.tm_hour << ":" << ti.tm_min << "\t" 
@@ -151,33 +458,104 @@ public:
     
     /*Print the time, direction, trades success, entry, stop loss, take profit and comment to the console*/
     void debug(){
+        debug([](const Trade &tr){return tr.comment;});
+    }
+
+    /*Print the time, direction, trades success, entry, stop loss, take profit and a comment built by a function to the console. The comment
+    is only built here, so the strategy can set Order::tag instead of formatting a comment for every order
+    @param comment function called with each trade, returns something printable e.g a std::string
+    */
+    template <typename F>
+    void debug(F &&comment){
         std::tm ti;
         time_t temp;
-        for (auto &tr : _trades){
+        for (auto &tr : _book.trades()){
             temp = tr.timestamp/1000;
             localtime_s(&ti, &temp);
             std::cout << ti.tm_year+1900 << "/" << ti.tm_mon+1 << "/" << ti.tm_mday << " " << ti.tm_hour << ":" << ti.tm_min << "\t" 
             << (tr.direction == Direction::buy? "buy" : "sell") << "\t" << (tr.success? "successful" : "not successful") 
-            << "\tent : " << tr.entry << "\tsl : " << tr.sl << "\ttp : " << tr.tp << "\t" << tr.comment << "\n";
+            << "\tent : " << tr.entry << "\tsl : " << tr.sl << "\ttp : " << tr.tp << "\t" << comment(tr) << "\n";
         }
     }
 
 private:
     std::vector<CandleStick> &_candles;
     Chart _chart;
-    void (*_strategy) (BackTest &);
+    strategy_type _strategy;
     size_t _index = 0;
-    std::vector<Trade> _trades;
-    std::priority_queue<Order, std::vector<Order>> _buy_limit; //Descending
-    std::priority_queue<Order, std::vector<Order>, std::greater<Order>> _sell_limit; //Ascending
+    size_t _next = 0; //Next candle of step()
+    Book _book;
+    Account _account;
     PerformanceMetric _metric;
+    Profiling _profiling;
     std::string _strategy_name;
+
+    //Chart of another timeframe and the number of its candles closed at each candle of the backtest
+    struct _Timeframe{
+        Chart *chart;
+        std::vector<size_t> closed;
+        size_t size = 0; //Candles of the chart when closed was computed
+    };
+    std::vector<_Timeframe> _timeframes;
+
+    //Fill of a signal in the vectorized mode
+    struct _Fill{
+        size_t index; //Candle of the fill
+        int group; //0 = buy, 1 = sell
+        Price key; //Order of the fills of a group on the same candle
+        size_t signal;
+        Price entry;
+    };
+
+    //Buffers of the vectorized mode, kept between runs so a screening of many variants doesn't allocate
+    struct _Batch{
+        std::vector<_Fill> fills, sorted;
+        std::vector<size_t> offsets; //Fills of candle k are sorted[offsets[k], offsets[k+1])
+        std::vector<size_t> cursor;
+        std::vector<std::pair<size_t, size_t>> exits; //(exit candle, trade)
+        std::vector<size_t> exit_offsets, exit_trades; //Trades exiting on candle k are exit_trades[exit_offsets[k], exit_offsets[k+1])
+        std::vector<int> opened; //Change of the number of open trades at each candle
+    };
+    _Batch _batch;
+
+    void _on_start(){
+        if constexpr (requires(strategy_type &s, BasicBackTest &engine){ s.on_start(engine); }) _strategy.on_start(*this);
+    }
+
+    void _on_candle(){
+        if constexpr (requires(strategy_type &s, BasicBackTest &engine){ s.on_candle(engine); }) _strategy.on_candle(*this);
+        else _strategy(*this);
+    }
+
+    /*Same loop as run() but times each step*/
+    void _run_profiled(){
+        using clock = std::chrono::steady_clock;
+        for (; _index < _candles.size(); ++_index){
+            auto t0 = clock::now();
+            _manage_trades();
+            auto t1 = clock::now();
+            _manage_orders();
+            auto t2 = clock::now();
+            _on_candle();
+            auto t3 = clock::now();
+            _update_dd();
+            auto t4 = clock::now();
+
+            _profiling.manage_trades += t1-t0;
+            _profiling.manage_orders += t2-t1;
+            _profiling.strategy += t3-t2;
+            _profiling.update_dd += t4-t3;
+            _profiling.strategy_latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(t3-t2).count());
+            _profiling.peak_open_trades = std::max(_profiling.peak_open_trades, _book.open_trades());
+            _profiling.peak_pending_orders = std::max(_profiling.peak_pending_orders, _book.pending_orders());
+        }
+    }
     
     
     /*Calculates useful information about the backtest*/
     void _run_analysis(){
         size_t consecutive_loss = 0, consecutive_win = 0;
-        for (auto &tr : _trades){
+        for (auto &tr : _book.trades()){
             if (tr.trade_completed){
                 if (tr.success){
                     if (tr.direction == Direction::sell) _metric.short_wins++;
@@ -194,102 +572,88 @@ private:
                 
                 if (consecutive_loss > _metric.max_loss_in_a_row) _metric.max_loss_in_a_row = consecutive_loss;
                 if (consecutive_win > _metric.max_win_in_a_row) _metric.max_win_in_a_row = consecutive_win;
-                _metric.risk_reward= tr.rr;
+                _metric.risk_reward += tr.rr;
                 ++_metric.n_trades;
             }
         }
-        _metric.returns = (_metric.equity-_metric.initial_equity)/_metric.initial_equity;
+        _metric.returns = _account.returns();
     }
     
     /*Manage trades. Responsible for checking if trades is successful or not*/
     void _manage_trades(){
-        for (Trade &tr : _trades){
-            if (!tr.trade_completed){
-                if (_candles[_index].low() < tr.sl && tr.direction == Direction::buy){
-                    tr.trade_completed = true;
-                    tr.success = false;
-                    tr.rr = -1;
-                }
-                else if (_candles[_index].high() > tr.sl && tr.direction == Direction::sell){
-                    tr.trade_completed = true;
-                    tr.success = false;
-                    tr.rr = -1;
-                }
-                else if (_candles[_index].low() < tr.tp && tr.direction == Direction::sell){
-                    tr.trade_completed = true;
-                    tr.success = true;
-                    tr.rr = (tr.entry-tr.tp)/ (tr.sl-tr.entry);
-                }
-                else if (_candles[_index].high() > tr.tp && tr.direction == Direction::buy){
-                    tr.trade_completed = true;
-                    tr.success = true;
-                    tr.rr = (tr.tp-tr.entry)/ (tr.entry-tr.sl);
-                }
-                if (tr.trade_completed) _update_balance(tr);
-            }
-        }
-    }
-    
-    // Execute an order
-    void _fill(const Order &od){
-        _trades.emplace_back(od.entry, od.sl, od.tp, _candles[_index].timestamp(), od.direction, std::move(od.comment));
+        _book.manage_trades(_index);
+        for (size_t i : _book.closed()) _account.apply(_book.trades()[i], risk);
     }
     
     /*Manage orders. Responsible for cancelling and filling orders*/
     void _manage_orders(){
-        while (!_buy_limit.empty()){
-            if (_candles[_index].low() <= _buy_limit.top().entry){
-                if (_index - _buy_limit.top().entry_id <= _buy_limit.top().cancel_after) _fill(_buy_limit.top());
-                _buy_limit.pop();
-            }
-            else break;
-        }
-        while (!_sell_limit.empty()){
-            if (_candles[_index].high() >= _sell_limit.top().entry){
-                if (_index - _sell_limit.top().entry_id <= _sell_limit.top().cancel_after) _fill(_sell_limit.top());
-                _sell_limit.pop();
-            }
-            else break;
-        }
+        _book.manage_orders(_index);
     }
     
-    //Update _equity 
-    void _update_balance(Trade &tr){
-        float reward = tr.rr * risk;
-        _metric.equity += _metric.equity*reward;
+    //Updates the drawdowns, the risk metrics and the equity curve at the close of the candle
+    void _update_dd(){
+        _account.end_step(_book.open_trades() > 0);
     }
     
-    //Update drawdowns
-    void _update_dd(){
-        if (_metric.equity >= _metric.max_equity){
-            _metric.max_equity = _metric.equity;
-            _metric.dd_duration = 0;
+    /*Computes the closed candles of a timeframe for the candles added to either chart since the last call. The entries that can change
+    are recomputed: the last candle of the backtest, whose close isn't known until the next one starts, and the candles that saw every
+    candle of the timeframe*/
+    void _align(_Timeframe &tf){
+        const std::vector<CandleStick> &other = tf.chart->candles();
+        const size_t n = _candles.size();
+        if (tf.closed.size() == n && tf.size == other.size()) return;
+        size_t i = tf.closed.empty() ? 0 : tf.closed.size()-1;
+        if (tf.size != other.size()){
+            size_t last = tf.size > 0 ? tf.size-1 : 0;
+            i = std::min<size_t>(i, std::lower_bound(tf.closed.begin(), tf.closed.end(), last) - tf.closed.begin());
         }
-        else {
-            float dd = (_metric.equity-_metric.max_equity)/_metric.equity;
-            if (++_metric.dd_duration > _metric.max_dd_duration)_metric.max_dd_duration = _metric.dd_duration;
-            if (dd < _metric.max_dd) _metric.max_dd = dd;
+        if (tf.size > other.size()) i = 0; // The chart was replaced
+        i = std::min(i, n > 0 ? n-1 : 0);
+        tf.closed.resize(n);
+        size_t started = i > 0 ? tf.closed[i-1]+1 : 0; // Candles of the timeframe started by the close of candle i
+        if (i > 0 && tf.closed[i-1] == 0) started = 0;
+        for (; i < n; i++){
+            const time_t end = i+1 < n ? _candles[i+1].timestamp() : _candles[i].timestamp();
+            while (started < other.size() && other[started].timestamp() <= end) started++;
+            tf.closed[i] = started > 0 ? started-1 : 0;
         }
+        tf.size = other.size();
     }
-    
-    //Checks if an order is proper
-    bool _check(Order &order){
-        if ((order.entry <= order.sl || order.tp <= order.entry) && order.direction == Direction::buy) return false;
-        else if ((order.entry >= order.sl || order.tp >= order.entry) && order.direction == Direction::sell) return false;
-        else if (order.order_type == OrderType::limit && order.direction == Direction::buy && order.entry > _candles[_index].close()) return false;
-        else if (order.order_type == OrderType::limit && order.direction == Direction::sell && order.entry < _candles[_index].close()) return false;
-        return true;
-    }
-    
+
     /* Resets all private variables.
     @note Does not reset public variables
     */
     void _reset(){
         _index = 0;
-        _trades = {};
-        _buy_limit = {};
-        _sell_limit = {};
+        _next = 0;
+        for (_Timeframe &tf : _timeframes) _align(tf);
+        _book.reset();
+        _account.reset();
         _metric = {};
+        _profiling = {};
     }
 };
 
+template <typename S>
+BasicBackTest(Chart &, S, const char * = "") -> BasicBackTest<S>;
+
+BasicBackTest(Chart &, void (*) (BasicBackTest<> &), const char * = "") -> BasicBackTest<>;
+
+/*Backtest engine whose strategy is a function void (*)(BackTest &)*/
+using BackTest = BasicBackTest<>;
+
+/*Runs several backtests, e.g the variants of a strategy, on the calling thread and the threads of tasks::global().
+@param engines random access range of engines or of pointers to engines e.g std::deque<BackTest> or std::vector<std::unique_ptr<BackTest>>
+@param max_concurrency maximum number of backtests running at the same time. 0 = threads of tasks::global() + 1
+@note The strategies should keep their state in the strategy object, not in globals. Every engine has its own copy of the chart but
+copies of a candle share its profile, call Chart::build_profiles() on the chart before constructing the engines
+*/
+template <typename Range>
+void run_all(Range &engines, size_t max_concurrency = 0){
+    auto first = std::begin(engines);
+    tasks::parallel_for(0, (size_t) std::size(engines), 1, [&](size_t i){
+        auto &&engine = first[i];
+        if constexpr (requires{ engine->run(); }) engine->run();
+        else engine.run();
+    }, max_concurrency);
+}
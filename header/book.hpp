@@ -0,0 +1,629 @@
+/*
+This file contains the trades and orders of one instrument and the account they are traded with. It is used by backtest.hpp and portfolio.hpp
+Book = trades and pending limit orders of one instrument
+OrderBook = pending limit orders sorted by price with eager expiry
+StringArena = storage for the comments of the trades
+RangeIndex = finds the first candle whose low or high crosses a price in O(log n)
+Account = equity, drawdown and risk metrics of an account
+*/
+
+#pragma once
+#include "defs.hpp"
+#include "candlestick.hpp"
+#include "order.hpp"
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <bit>
+#include <functional>
+#include <memory>
+#include <cstring>
+#include <string_view>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+
+/*Storage for the comments of the trades. Strings are copied into large blocks that never move, so the views returned stay valid
+until clear(). clear() keeps the blocks, so a run that stores as many comments as the previous one does not allocate.
+*/
+class StringArena{
+public:
+    /*Copies a string into the arena
+    @return view of the copy
+    */
+    std::string_view store(std::string_view str){
+        if (str.empty()) return {};
+        while (_block < _blocks.size() && _used + str.size() > _blocks[_block].second){
+            _block++;
+            _used = 0;
+        }
+        if (_block == _blocks.size()){
+            size_t size = std::max(_block_size, str.size());
+            _blocks.emplace_back(std::make_unique<char[]>(size), size);
+            _used = 0;
+        }
+        char *dest = _blocks[_block].first.get() + _used;
+        std::memcpy(dest, str.data(), str.size());
+        _used += str.size();
+        return std::string_view(dest, str.size());
+    }
+
+    //Invalidates every view returned. The memory is kept
+    void clear(){
+        _block = 0;
+        _used = 0;
+    }
+
+private:
+    static constexpr size_t _block_size = 1 << 16;
+    std::vector<std::pair<std::unique_ptr<char[]>, size_t>> _blocks;
+    size_t _block = 0; //Block being filled
+    size_t _used = 0; //Bytes used in the block being filled
+};
+
+/*Index over the lows and highs of candles that finds the first candle after a given one whose low is below (or high above) a price,
+e.g the candle a trade hits its stop loss on. Candles are grouped in blocks of 64 with sparse tables of the minimum low and maximum high
+of 2^j consecutive blocks. A query scans the rest of its block, gallops over the tables to the first block that crosses the price and
+scans that block, so it costs O(log n) whatever the distance.
+*/
+class RangeIndex{
+public:
+    //Builds the index over candles
+    void build(const std::vector<CandleStick> &candles){
+        const size_t n = candles.size(), blocks = (n+_block-1)/_block;
+        _low.resize(n), _high.resize(n);
+        for (size_t i = 0; i < n; i++){
+            _low[i] = candles[i].low();
+            _high[i] = candles[i].high();
+        }
+        size_t levels = blocks > 0 ? std::bit_width(blocks) : 0;
+        _min.resize(levels), _max.resize(levels);
+        if (levels == 0) return;
+        _min[0].resize(blocks), _max[0].resize(blocks);
+        for (size_t b = 0; b < blocks; b++){
+            size_t last = std::min(n, (b+1)*_block);
+            _min[0][b] = *std::min_element(_low.begin()+b*_block, _low.begin()+last);
+            _max[0][b] = *std::max_element(_high.begin()+b*_block, _high.begin()+last);
+        }
+        for (size_t j = 1; j < levels; j++){
+            size_t half = (size_t) 1 << (j-1), count = blocks - ((size_t) 1 << j) + 1;
+            _min[j].resize(count), _max[j].resize(count);
+            for (size_t b = 0; b < count; b++){
+                _min[j][b] = std::min(_min[j-1][b], _min[j-1][b+half]);
+                _max[j][b] = std::max(_max[j-1][b], _max[j-1][b+half]);
+            }
+        }
+    }
+
+    //@return number of candles indexed
+    size_t size() const {return _low.size();}
+
+    //@return index of the first candle at or after first with a low strictly below price, size() if there is none
+    size_t first_low_below(size_t first, Price price) const {
+        return _first(_low, _min, first, [price](float x){return x < price;});
+    }
+
+    //@return index of the first candle at or after first with a high strictly above price, size() if there is none
+    size_t first_high_above(size_t first, Price price) const {
+        return _first(_high, _max, first, [price](float x){return x > price;});
+    }
+
+private:
+    static constexpr size_t _block = 64;
+    std::vector<float> _low, _high;
+    std::vector<std::vector<float>> _min, _max; //_min[j][b] = minimum low of the blocks [b, b+2^j)
+
+    /*@return first index in [first, last) where hit is true, last if there is none. Groups of 8 are tested without branching so the
+    compiler can vectorize the scan*/
+    template <typename P>
+    static size_t _scan(const float *x, size_t first, size_t last, P hit){
+        size_t k = first;
+        for (; k+8 <= last; k += 8){
+            bool any = false;
+            for (size_t j = 0; j < 8; j++) any |= hit(x[k+j]);
+            if (any) break;
+        }
+        for (; k < last; k++) if (hit(x[k])) return k;
+        return last;
+    }
+
+    template <typename P>
+    static size_t _first(const std::vector<float> &x, const std::vector<std::vector<float>> &table, size_t first, P hit){
+        const size_t n = x.size();
+        if (first >= n) return n;
+        size_t b = first/_block;
+        size_t k = _scan(x.data(), first, std::min(n, (b+1)*_block), hit);
+        if (k < std::min(n, (b+1)*_block)) return k;
+
+        const size_t blocks = table[0].size();
+        size_t j = 0;
+        for (b++; b < blocks;){
+            while (b + ((size_t) 1 << j) > blocks) j--;
+            if (hit(table[j][b])){
+                // The hit is in the blocks [b, b+2^j), halve the range until it is one block
+                while (j-- > 0) if (!hit(table[j][b])) b += (size_t) 1 << j;
+                return _scan(x.data(), b*_block, std::min(n, (b+1)*_block), hit);
+            }
+            b += (size_t) 1 << j;
+            if (j+1 < table.size()) j++;
+        }
+        return n;
+    }
+};
+
+/*Pending limit orders of one instrument. Orders are stored in a pool and referenced by index, the buy and sell books keep the indexes
+sorted by price so all the orders triggered by a candle are filled in one sweep from the end of the book. Expiry is kept in a timing wheel
+keyed by the first candle an order can no longer be filled on (entry_id + cancel_after + 1), so expired orders leave the books when they
+expire instead of when price reaches them. The books only hold live orders.
+@note advance() should be called with increasing candle indexes
+*/
+class OrderBook{
+public:
+    //Adds a limit order. entry_id should be set
+    void add(const Order &order){
+        uint32_t id = _acquire(order);
+        if (order.direction == Direction::buy){
+            // Ascending, highest at the end. Equal prices are filled in the order they were added
+            auto it = std::lower_bound(_buy.begin(), _buy.end(), order.entry, [](const Entry &e, Price p){return e.price < p;});
+            _buy.insert(it, Entry{order.entry, id});
+        }
+        else {
+            // Descending, lowest at the end
+            auto it = std::lower_bound(_sell.begin(), _sell.end(), order.entry, [](const Entry &e, Price p){return e.price > p;});
+            _sell.insert(it, Entry{order.entry, id});
+        }
+        if (order.cancel_after < SIZE_MAX - order.entry_id){ // SIZE_MAX never expires
+            size_t expiry = order.entry_id + order.cancel_after + 1;
+            _wheel[expiry & (_slots-1)].push_back(Expiry{expiry, id, _generation[id]});
+        }
+    }
+
+    /*Removes the orders that can't be filled on the candle at index anymore
+    @param index index of the current candle
+    */
+    void advance(size_t index){
+        if (_next > index) return;
+        size_t first = index-_next >= _slots ? index-_slots+1 : _next;
+        for (size_t t = first; t <= index; t++){
+            std::vector<Expiry> &slot = _wheel[t & (_slots-1)];
+            for (size_t i = 0; i < slot.size();){
+                if (slot[i].expiry <= index){
+                    if (_generation[slot[i].id] == slot[i].generation) _cancel(slot[i].id);
+                    slot[i] = slot.back();
+                    slot.pop_back();
+                }
+                else i++;
+            }
+        }
+        _next = index+1;
+    }
+
+    /*Fills the buy orders with an entry at or above low and the sell orders with an entry at or below high. Buy orders are filled from the
+    highest entry, sell orders from the lowest
+    @param low low of the candle
+    @param high high of the candle
+    @param fill function called with each triggered order
+    */
+    template <typename F>
+    void sweep(Price low, Price high, F &&fill){
+        while (!_buy.empty() && _buy.back().price >= low){
+            uint32_t id = _buy.back().id;
+            _buy.pop_back();
+            fill(_orders[id]);
+            _release(id);
+        }
+        while (!_sell.empty() && _sell.back().price <= high){
+            uint32_t id = _sell.back().id;
+            _sell.pop_back();
+            fill(_orders[id]);
+            _release(id);
+        }
+    }
+
+    //@return number of live orders
+    size_t size() const {return _buy.size()+_sell.size();}
+
+    //Removes all orders. The memory is kept for the next run
+    void clear(){
+        _buy.clear();
+        _sell.clear();
+        for (auto &slot : _wheel) slot.clear();
+        _free.clear();
+        for (uint32_t id = 0; id < _orders.size(); id++){
+            _generation[id]++;
+            _free.push_back(id);
+        }
+        _next = 0;
+    }
+
+private:
+    struct Entry{
+        Price price;
+        uint32_t id;
+    };
+
+    struct Expiry{
+        size_t expiry;
+        uint32_t id;
+        uint32_t generation; //Generation of the pool slot when the order was added. The slot may have been reused since
+    };
+
+    static constexpr size_t _slots = 256; //Orders expiring more than _slots candles ahead stay in their slot for more turns
+
+    std::vector<Order> _orders; //Pool
+    std::vector<uint32_t> _generation;
+    std::vector<uint32_t> _free;
+    std::vector<Entry> _buy, _sell;
+    std::vector<std::vector<Expiry>> _wheel = std::vector<std::vector<Expiry>>(_slots);
+    size_t _next = 0; //Next candle index to expire
+
+    uint32_t _acquire(const Order &order){
+        if (_free.empty()){
+            _orders.push_back(order);
+            _generation.push_back(0);
+            return _orders.size()-1;
+        }
+        uint32_t id = _free.back();
+        _free.pop_back();
+        _orders[id] = order;
+        return id;
+    }
+
+    void _release(uint32_t id){
+        _generation[id]++;
+        _free.push_back(id);
+    }
+
+    void _cancel(uint32_t id){
+        const Order &order = _orders[id];
+        std::vector<Entry> &book = order.direction == Direction::buy ? _buy : _sell;
+        auto it = order.direction == Direction::buy ?
+        std::lower_bound(book.begin(), book.end(), order.entry, [](const Entry &e, Price p){return e.price < p;}) :
+        std::lower_bound(book.begin(), book.end(), order.entry, [](const Entry &e, Price p){return e.price > p;});
+        while (it->id != id) ++it;
+        book.erase(it);
+        _release(id);
+    }
+};
+
+/*Trades and pending limit orders of one instrument. A Book does not touch the equity, the trades completed by manage_trades() are listed in
+closed() so the engine can apply them to the account in its own order.
+
+The exit of a trade is found when it is filled, with a RangeIndex over the candles, and kept in a min-heap of exits. manage_trades() only
+looks at the trades that exit on the current candle, so an open trade costs nothing while it is held.
+@param candles candles of the instrument
+@note The index is built by reset(), or on the first fill if the number of candles changed. Call reset() if the candles were modified
+*/
+class Book{
+public:
+    Book(const std::vector<CandleStick> &candles) : _candles(&candles){}
+
+    /*Adds an order. Market orders are filled at the close of the candle at index, limit orders wait in the book
+    @param order order to add. Its entry_id is set to index. Its comment is copied into the book when it is filled
+    @param index index of the current candle
+    @return true if the order is proper and was added
+    */
+    bool add_order(Order &order, size_t index){
+        if (!check(order, index)) return false;
+        order.entry_id = index;
+        if (order.order_type == OrderType::market_order){
+            order.entry = (*_candles)[index].close();
+            _fill(order, index);
+        }
+        else _pending.add(order);
+        return true;
+    }
+
+    /*Completes the trades that hit their stop loss or take profit on the candle at index. The stop loss is checked first.
+    Completed trades are listed in closed(), in the order they were filled
+    @note Should be called on every candle, in order. Candles can be added after reset() (e.g live), the trades whose exit wasn't
+    found in the indexed candles are then checked against each new candle
+    */
+    void manage_trades(size_t index){
+        _closed.clear();
+        if (index >= _range.size() && !_unresolved.empty()) _check_unresolved(index);
+        while (!_exits.empty() && _exits.front().index <= index){
+            std::pop_heap(_exits.begin(), _exits.end(), std::greater<Exit>());
+            Exit ex = _exits.back();
+            _exits.pop_back();
+            Trade &tr = _trades[ex.trade];
+            tr.trade_completed = true;
+            tr.success = ex.success;
+            if (!tr.success) tr.rr = -1;
+            else if (tr.direction == Direction::buy) tr.rr = (tr.tp-tr.entry)/ (tr.entry-tr.sl);
+            else tr.rr = (tr.entry-tr.tp)/ (tr.sl-tr.entry);
+            _closed.push_back(ex.trade);
+            _open_trades--;
+        }
+    }
+
+    /*Finds the exit of a trade filled on the candle at fill. It is checked from the next candle, the stop loss first
+    @param tr trade
+    @param fill index of the candle the trade was filled on
+    @param success set to true if the take profit is hit first
+    @return index of the candle the trade exits on. Number of candles if it never exits
+    */
+    size_t find_exit(const Trade &tr, size_t fill, bool &success) const {
+        size_t loss, win;
+        if (tr.direction == Direction::buy){
+            loss = _range.first_low_below(fill+1, tr.sl);
+            win = _range.first_high_above(fill+1, tr.tp);
+        }
+        else {
+            loss = _range.first_high_above(fill+1, tr.sl);
+            win = _range.first_low_below(fill+1, tr.tp);
+        }
+        success = win < loss;
+        return std::min(win, loss);
+    }
+
+    //@return index over the candles. Built by reset()
+    const RangeIndex &range() const {return _range;}
+
+    /*Drops the limit orders that waited more than cancel_after candles and fills the ones triggered by the candle at index
+    @note Should be called on every candle, in order
+    */
+    void manage_orders(size_t index){
+        const CandleStick &candle = (*_candles)[index];
+        _pending.advance(index);
+        _pending.sweep(candle.low(), candle.high(), [this, index](const Order &od){_fill(od, index);});
+    }
+
+    /*Adds a trade simulated outside the book e.g by a vectorized backtest. It counts as open until it is completed
+    @param tr trade to add. Its comment should outlive the book or be empty
+    */
+    void add_trade(const Trade &tr){
+        _trades.push_back(tr);
+        if (!tr.trade_completed) _open_trades++;
+    }
+
+    //Checks if an order is proper
+    bool check(const Order &order, size_t index) const {
+        const CandleStick &candle = (*_candles)[index];
+        if ((order.entry <= order.sl || order.tp <= order.entry) && order.direction == Direction::buy) return false;
+        else if ((order.entry >= order.sl || order.tp >= order.entry) && order.direction == Direction::sell) return false;
+        else if (order.order_type == OrderType::limit && order.direction == Direction::buy && order.entry > candle.close()) return false;
+        else if (order.order_type == OrderType::limit && order.direction == Direction::sell && order.entry < candle.close()) return false;
+        return true;
+    }
+
+    //@return trades taken. Their comments are valid until reset()
+    const std::vector<Trade> &trades() const {return _trades;}
+
+    //@return indexes in trades() of the trades completed by the last manage_trades()
+    const std::vector<size_t> &closed() const {return _closed;}
+
+    //@return number of trades not yet completed
+    size_t open_trades() const {return _open_trades;}
+
+    //@return number of limit orders waiting to be filled
+    size_t pending_orders() const {return _pending.size();}
+
+    //Removes all trades, orders and comments and builds the index over the candles. The memory is kept for the next run
+    void reset(){
+        _range.build(*_candles);
+        _exits.clear();
+        _trades.clear();
+        _closed.clear();
+        _comments.clear();
+        _pending.clear();
+        _unresolved.clear();
+        _open_trades = 0;
+    }
+
+private:
+    const std::vector<CandleStick> *_candles;
+    std::vector<Trade> _trades;
+    std::vector<size_t> _closed;
+    OrderBook _pending;
+    StringArena _comments;
+    size_t _open_trades = 0;
+    RangeIndex _range;
+
+    struct Exit{
+        size_t index; //Candle the trade exits on
+        size_t trade;
+        bool success;
+
+        friend bool operator>(const Exit &l, const Exit &r){
+            return l.index != r.index ? l.index > r.index : l.trade > r.trade;
+        }
+    };
+    std::vector<Exit> _exits; //Min-heap of the exits of the open trades
+    std::vector<size_t> _unresolved; //Open trades without an exit in the indexed candles
+
+    /*Indexes the candles added since the last build. The unresolved trades have been checked up to the candle at index, their exit is
+    searched again in the candles after it*/
+    void _rebuild(size_t index){
+        _range.build(*_candles);
+        size_t kept = 0;
+        for (size_t id : _unresolved){
+            bool success;
+            size_t exit = find_exit(_trades[id], index, success);
+            if (exit < _range.size()){
+                _exits.push_back(Exit{exit, id, success});
+                std::push_heap(_exits.begin(), _exits.end(), std::greater<Exit>());
+            }
+            else _unresolved[kept++] = id;
+        }
+        _unresolved.resize(kept);
+    }
+
+    //Finds the unresolved trades that exit on the candle at index, which is after the indexed candles
+    void _check_unresolved(size_t index){
+        const CandleStick &candle = (*_candles)[index];
+        size_t kept = 0;
+        for (size_t id : _unresolved){
+            const Trade &tr = _trades[id];
+            bool loss, win;
+            if (tr.direction == Direction::buy) loss = candle.low() < tr.sl, win = candle.high() > tr.tp;
+            else loss = candle.high() > tr.sl, win = candle.low() < tr.tp;
+            if (loss || win){
+                _exits.push_back(Exit{index, id, !loss});
+                std::push_heap(_exits.begin(), _exits.end(), std::greater<Exit>());
+            }
+            else _unresolved[kept++] = id;
+        }
+        _unresolved.resize(kept);
+    }
+
+    // Execute an order
+    void _fill(const Order &od, size_t index){
+        _trades.emplace_back(od.entry, od.sl, od.tp, (*_candles)[index].timestamp(), od.direction, _comments.store(od.comment), od.tag);
+        _open_trades++;
+        if (index+1 >= _candles->size()){ // No candle after the fill yet
+            _unresolved.push_back(_trades.size()-1);
+            return;
+        }
+        if (_range.size() != _candles->size()) _rebuild(index);
+        bool success;
+        size_t exit = find_exit(_trades.back(), index, success);
+        if (exit < _range.size()){
+            _exits.push_back(Exit{exit, _trades.size()-1, success});
+            std::push_heap(_exits.begin(), _exits.end(), std::greater<Exit>());
+        }
+        else _unresolved.push_back(_trades.size()-1);
+    }
+};
+
+/*Point of the equity curve, recorded at the end of each step of the simulation*/
+struct EquityPoint{
+    float equity;
+    float drawdown; //Current drawdown i.e equity/peak equity - 1. 0 at a new peak
+};
+
+/*Equity and drawdown of an account. Trades are compounded i.e a trade risks a fraction of the current equity.
+
+The account also records the equity curve and keeps risk metrics up to date while the simulation runs (Welford's algorithm for the
+mean and variance of the returns), so they can be read after a run without another pass over the trades or the curve.
+*/
+struct Account{
+    float max_dd = 0; // Maximum drawdown i.e the lowest equity/peak equity - 1. See EquityPoint::drawdown
+    Quantity initial_equity = 10'000; //Starting equity. i.e equity at the start
+    Quantity equity = initial_equity; //Current equity
+    Quantity max_equity = initial_equity; //Peak equity during the entire simulation
+
+    /*Longest duration of a drawdown. There could be multiple drawdown in a simulation, it measures the longest drawdown.
+     @note It is unrelated to max drawdown*/
+    long long max_dd_duration = 0;
+
+    long long dd_duration = 0; //Current drawdown duration. 0 if it is not in a drawdown
+
+    std::vector<EquityPoint> curve; //Equity and drawdown at the end of each step
+
+    /*Applies the result of a completed trade to the equity
+    @param tr completed trade
+    @param risk fraction of the equity risked by the trade
+    */
+    void apply(const Trade &tr, float risk){
+        float reward = tr.rr * risk;
+        double change = equity*reward;
+        equity += change;
+        if (change > 0) _gross_profit += change;
+        else _gross_loss -= change;
+        _sum_rr += tr.rr;
+        _closed++;
+    }
+
+    //Updates the drawdowns. Called once per step of the simulation
+    void update_dd(){
+        if (equity >= max_equity){
+            max_equity = equity;
+            dd_duration = 0;
+        }
+        else {
+            float dd = equity/max_equity - 1; // Same as the drawdown of the equity curve
+            if (++dd_duration > max_dd_duration) max_dd_duration = dd_duration;
+            if (dd < max_dd) max_dd = dd;
+        }
+    }
+
+    /*Ends a step of the simulation. Updates the drawdowns, the statistics of the returns and the exposure, and records the equity curve
+    @param in_market true if a trade was open at the end of the step
+    */
+    void end_step(bool in_market){
+        update_dd();
+        double r = equity/_prev_equity - 1;
+        _prev_equity = equity;
+        _steps++;
+        double delta = r-_mean;
+        _mean += delta/_steps;
+        _m2 += delta*(r-_mean);
+        if (r < 0) _downside += r*r;
+        _in_market += in_market;
+        curve.push_back(EquityPoint{equity, equity/max_equity - 1});
+    }
+
+    //@return returns since the start @note Not in percentage
+    float returns() const {return (equity-initial_equity)/initial_equity;}
+
+    /*@return Sharpe ratio of the returns per step, with a risk free rate of 0. 0 if it is undefined
+    @param periods number of steps in the period it is scaled to e.g 365 for daily candles scaled to a year. 1 means per step
+    */
+    double sharpe(double periods = 1) const {
+        double std = _steps > 1 ? std::sqrt(_m2/(_steps-1)) : 0;
+        return std > 0 ? _mean/std*std::sqrt(periods) : 0;
+    }
+
+    /*@return Sortino ratio of the returns per step i.e the mean over the downside deviation, with a target of 0. 0 if it is undefined
+    @param periods number of steps in the period it is scaled to. 1 means per step
+    */
+    double sortino(double periods = 1) const {
+        double downside = _steps > 0 ? std::sqrt(_downside/_steps) : 0;
+        return downside > 0 ? _mean/downside*std::sqrt(periods) : 0;
+    }
+
+    //@return returns over the absolute maximum drawdown. 0 if there was no drawdown
+    double calmar() const {return max_dd < 0 ? returns()/-max_dd : 0;}
+
+    //@return gross profit over gross loss. 0 if there was no loss
+    double profit_factor() const {return _gross_loss > 0 ? _gross_profit/_gross_loss : 0;}
+
+    //@return average reward to risk of the completed trades i.e the expected result of a trade in R
+    double expectancy() const {return _closed > 0 ? _sum_rr/_closed : 0;}
+
+    //@return fraction of the steps that ended with a trade open
+    double exposure() const {return _steps > 0 ? (double) _in_market/_steps : 0;}
+
+    //Resets the account to its initial equity. The memory of the curve is kept
+    void reset(){
+        std::vector<EquityPoint> c = std::move(curve);
+        c.clear();
+        Quantity initial = initial_equity;
+        *this = Account();
+        initial_equity = equity = max_equity = _prev_equity = initial;
+        curve = std::move(c);
+    }
+
+    /*Writes the equity curve. A .csv file has a header and one line per step (step, timestamp, equity, drawdown), any other file is
+    binary with 16 bytes per step (timestamp as int64, equity and drawdown as float32)
+    @param file_path path of the file
+    @param timestamp function returning the timestamp of a step
+    */
+    template <typename F>
+    void write_curve(const char *file_path, F &&timestamp) const {
+        bool csv = std::filesystem::path(file_path).extension() == ".csv";
+        std::ofstream file(file_path, csv ? std::ios::out : std::ios::out | std::ios::binary);
+        if (!file) throw std::logic_error("cause = write_curve() : File not opened\n");
+        if (csv) file << "step,timestamp,equity,drawdown\n" << std::setprecision(9);
+        for (size_t i = 0; i < curve.size(); i++){
+            int64_t time = timestamp(i);
+            if (csv) file << i << ',' << time << ',' << curve[i].equity << ',' << curve[i].drawdown << '\n';
+            else {
+                file.write(reinterpret_cast<const char *>(&time), sizeof(time));
+                file.write(reinterpret_cast<const char *>(&curve[i].equity), sizeof(float));
+                file.write(reinterpret_cast<const char *>(&curve[i].drawdown), sizeof(float));
+            }
+        }
+    }
+
+private:
+    double _prev_equity = 10'000;
+    size_t _steps = 0;
+    double _mean = 0, _m2 = 0; //Mean and sum of squared deviations of the returns per step
+    double _downside = 0; //Sum of the squared negative returns
+    size_t _in_market = 0;
+    double _gross_profit = 0, _gross_loss = 0;
+    double _sum_rr = 0;
+    size_t _closed = 0;
+};
@@ -0,0 +1,232 @@
+/*
+This file contains code to cache aggregated data on disk.
+An entry is keyed by a fingerprint of the input file (size, modification time and a hash of its content) and the aggregation
+parameters, so a repeated aggregation of an unchanged file becomes a load of the cached binary result.
+*/
+#pragma once
+
+#include "defs.hpp"
+#include "aggregator.hpp"
+#include "chart.hpp"
+#include <filesystem>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <charconv>
+#include <random>
+#include <chrono>
+
+namespace cache{
+
+    /*Configuration of the aggregation cache
+    @param dir directory where the cached charts are stored. It is created if it doesn't exist
+    @param max_bytes maximum size of the cache directory. The least recently used entries are evicted when it is exceeded
+    @param handler_tag name of the data handler. Part of the key, since different handlers parse the same file differently
+    */
+    struct Config{
+        std::string dir;
+        std::uintmax_t max_bytes = 1ull << 30;
+        std::string handler_tag = "binance";
+    };
+
+    namespace {
+        const uint64_t __magic__ = 0x3230434d4647524full; // "ORGFMC02"
+        const size_t __sample_size__ = 1 << 20; // Bytes hashed from the start, middle and end of the input file
+
+        /*@brief 64-bit FNV-1a hash
+        @param data bytes to hash
+        @param n number of bytes
+        @param hash previous hash. Used to chain several calls
+        */
+        inline uint64_t __fnv1a__(const char *data, size_t n, uint64_t hash = 14695981039346656037ull){
+            for (size_t i = 0; i < n; i++){
+                hash ^= (unsigned char) data[i];
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        inline std::string __hex__(uint64_t x){
+            char buf[17];
+            std::snprintf(buf, sizeof(buf), "%016llx", (unsigned long long) x);
+            return buf;
+        }
+
+        inline std::filesystem::path __entry_path__(const Config &config, const std::string &key){
+            return std::filesystem::path(config.dir) / (__hex__(__fnv1a__(key.data(), key.size())) + ".fpc");
+        }
+    }
+    //namespace end
+
+    /*@brief Computes the fingerprint of a file. It hashes the size, the modification time and the content at the start, middle
+    and end of the file. Hashing samples instead of the whole file keeps a cache hit cheap on multi-GB inputs.
+    @param path location of the file
+    @return fingerprint of the file
+    */
+    inline uint64_t fingerprint(const std::string &path){
+        std::uintmax_t size = std::filesystem::file_size(path);
+        long long mtime = std::filesystem::last_write_time(path).time_since_epoch().count();
+        uint64_t hash = __fnv1a__(reinterpret_cast<const char *>(&size), sizeof(size));
+        hash = __fnv1a__(reinterpret_cast<const char *>(&mtime), sizeof(mtime), hash);
+
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        if (!file) throw std::logic_error("cause = cache::fingerprint() : File not opened\n");
+        std::vector<char> buf(__sample_size__);
+        std::uintmax_t offsets[] = {0, size/2, size > __sample_size__ ? size-__sample_size__ : 0};
+        for (std::uintmax_t off : offsets){
+            file.clear();
+            file.seekg(off);
+            file.read(buf.data(), buf.size());
+            hash = __fnv1a__(buf.data(), file.gcount(), hash);
+        }
+        return hash;
+    }
+
+    /*@brief Builds the cache key of an aggregation
+    @return key. Equal keys mean the aggregated output is the same
+    */
+    inline std::string key(const std::string &path, const std::string &handler_tag, const Price price_level_interval,
+            const int time_interval, size_t skip){
+        char interval[32]; // Shortest text that reads back as the same float, so different intervals never share a key
+        std::string_view price(interval, std::to_chars(interval, interval+sizeof(interval), price_level_interval).ptr - interval);
+        std::ostringstream out;
+        out << __hex__(fingerprint(path)) << ' ' << handler_tag << ' ' << price << ' ' << time_interval << ' ' << skip;
+        return out.str();
+    }
+
+    /*@brief Loads a cached chart. The candles are added after the candles of the chart, only once the whole entry has been read
+    @param config cache configuration
+    @param key key of the entry. See key()
+    @param chart chart where the candles are loaded into
+    @param lines number of lines read when the entry was aggregated
+    @return true if the entry exists, false otherwise. An entry that is truncated or doesn't hold the number of candles it was written
+    with is a miss
+    */
+    inline bool lookup(const Config &config, const std::string &key, Chart &chart, size_t &lines){
+        std::filesystem::path entry = __entry_path__(config, key);
+        std::ifstream file(entry, std::ios::in | std::ios::binary);
+        if (!file) return false;
+
+        uint64_t magic = 0, key_size = 0, n_lines = 0, n_candles = 0;
+        file.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+        file.read(reinterpret_cast<char *>(&key_size), sizeof(key_size));
+        if (!file || magic != __magic__ || key_size != key.size()) return false;
+        std::string stored(key_size, '\0');
+        file.read(stored.data(), key_size);
+        file.read(reinterpret_cast<char *>(&n_lines), sizeof(n_lines));
+        file.read(reinterpret_cast<char *>(&n_candles), sizeof(n_candles));
+        if (!file || stored != key) return false;
+
+        std::vector<CandleStick> candles;
+        while (candles.size() < n_candles){
+            CandleStick c(chart.resource());
+            if (!c.read_bin(file)) return false;
+            candles.push_back(std::move(c));
+        }
+        if (file.peek() != std::char_traits<char>::eof()) return false;
+        for (auto &c : candles) chart.push_back(std::move(c));
+        lines = n_lines;
+
+        std::error_code ec;
+        std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), ec); // Marks the entry as recently used
+        return true;
+    }
+
+    /*@brief Evicts the least recently used entries until the cache directory is not larger than config.max_bytes
+    @param config cache configuration
+    */
+    inline void evict(const Config &config){
+        struct Entry{
+            std::filesystem::path path;
+            std::filesystem::file_time_type used;
+            std::uintmax_t size;
+        };
+        std::vector<Entry> entries;
+        std::uintmax_t total = 0;
+        std::error_code ec;
+        for (auto &x : std::filesystem::directory_iterator(config.dir, ec)){
+            if (x.path().extension() != ".fpc") continue;
+            entries.push_back({x.path(), x.last_write_time(), x.file_size()});
+            total += entries.back().size;
+        }
+        std::sort(entries.begin(), entries.end(), [](const Entry &l, const Entry &r){return l.used < r.used;});
+        for (auto &x : entries){
+            if (total <= config.max_bytes) break;
+            if (std::filesystem::remove(x.path, ec)) total -= x.size;
+        }
+    }
+
+    /*@brief Stores aggregated candles in the cache, then evicts entries if the cache is too large.
+    @param config cache configuration
+    @param key key of the entry. See key()
+    @param candles aggregated candles
+    @param lines number of lines read during the aggregation
+    @return false if the entry couldn't be written e.g the disk is full. The cache is then left as it was
+    */
+    inline bool insert(const Config &config, const std::string &key, const std::vector<CandleStick> &candles, size_t lines){
+        std::filesystem::create_directories(config.dir);
+        std::filesystem::path entry = __entry_path__(config, key);
+        // Each writer has its own temporary file, so processes missing on the same key don't write to the same file
+        std::random_device device;
+        uint64_t id = ((uint64_t) device() << 32) ^ device() ^ std::chrono::steady_clock::now().time_since_epoch().count();
+        std::filesystem::path temp = entry;
+        temp += "." + __hex__(id) + ".tmp";
+        std::error_code ec;
+        {
+            std::ofstream file(temp, std::ios::out | std::ios::binary);
+            if (!file) throw std::logic_error("cause = cache::insert() : File not opened\n");
+            uint64_t magic = __magic__, key_size = key.size(), n_lines = lines, n_candles = candles.size();
+            file.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+            file.write(reinterpret_cast<const char *>(&key_size), sizeof(key_size));
+            file.write(key.data(), key.size());
+            file.write(reinterpret_cast<const char *>(&n_lines), sizeof(n_lines));
+            file.write(reinterpret_cast<const char *>(&n_candles), sizeof(n_candles));
+            for (auto &c : candles) c.write_bin(file);
+            file.flush();
+            if (file.good()) file.close();
+            if (!file.good()){
+                file.close();
+                std::filesystem::remove(temp, ec);
+                return false;
+            }
+        }
+        // Renaming makes the entry visible atomically, so another process never reads a half written entry
+        std::filesystem::rename(temp, entry, ec);
+        if (ec){
+            std::filesystem::remove(temp, ec);
+            return false;
+        }
+        evict(config);
+        return true;
+    }
+}
+
+namespace aggregator{
+
+    /*@brief Aggregates the data into chart, reusing a previous aggregation from the on-disk cache when the input file and the
+    parameters have not changed.
+
+    @param path location of the file to be read from
+    @param handler data handler. Basically a function that parses a line of csv and returns RowData.
+    @param chart chart that will contain the candlesticks
+    @param price_level_interval the price difference between each price level. It determines each price level of the footprint
+    @param time_interval time interval (in seconds)
+    @param skip number of lines to skip. Sometimes the first few lines are not data but other information e.g column names
+    @param config cache configuration. @note config.handler_tag should differ for different handlers
+    @return number of lines read
+    @note The result is still returned if it couldn't be written to the cache
+    */
+    inline size_t aggregate_cached(const std::string &path,  RowData (*handler) (data::FileStream &), Chart &chart,
+            const Price price_level_interval, const int time_interval, size_t skip, const cache::Config &config){
+
+        std::string key = cache::key(path, config.handler_tag, price_level_interval, time_interval, skip);
+        size_t lines = 0;
+        if (cache::lookup(config, key, chart, lines)) return lines;
+
+        std::vector<CandleStick> candles;
+        lines = __tagg__(path, handler, "", candles, price_level_interval, time_interval, false, skip, nullptr, chart.resource());
+        cache::insert(config, key, candles, lines);
+        for (auto &c : candles) chart.push_back(std::move(c));
+        return lines;
+    }
+}
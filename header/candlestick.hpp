@@ -11,6 +11,7 @@ CandleStick = a replica object of a candlestick
 #include <utility>
 #include <memory>
 #include <limits>
+#include <cstdint>
 
 /*Object storing information about the candlestick
 @param open open of the candle
@@ -19,7 +20,10 @@ CandleStick = a replica object of a candlestick
 @param close close of the candle
 @param time open time of the candle
 @param footprint footprint of the candle
-@note The data in ```footprint``` is moved into the object. After the constructor call, ```footprint``` would be empty.
+@note The data in ```footprint``` is moved into the object. After the constructor call, ```footprint``` would be empty. The candle keeps
+the memory resource of ```footprint```
+@note A moved candle keeps the memory resource of its footprint e.g the arena of a chart (see Chart::resource()) while a copy allocates
+from the default resource. A candle moved out of a chart should not outlive the chart
 */
 class CandleStick{
 public:
@@ -29,6 +33,10 @@ public:
     double percentage = 0.7;
     
     CandleStick() = default;
+
+    /*Empty candle whose footprint is allocated from resource e.g before reading it from a stream
+    @note resource should outlive the candle*/
+    explicit CandleStick(std::pmr::memory_resource *resource) : _footprint(resource){}
     
     CandleStick(Price open, Price high, Price low, Price close, time_t time){
         _open = open;
@@ -38,13 +46,12 @@ public:
         _time_stamp = time;
     }
 
-    CandleStick(Price open, Price high, Price low, Price close, time_t time, std::map<Price, Level, std::greater<Price>> &footprint){
+    CandleStick(Price open, Price high, Price low, Price close, time_t time, Footprint &footprint) : _footprint(std::move(footprint)){
         _open = open;
         _high = high;
         _low = low;
         _close = close;
         _time_stamp = time;
-        _footprint = std::move(footprint);
         _profile = std::shared_ptr<Profile>(new Profile);
         _contains_fp = true;
     }
@@ -181,7 +188,7 @@ public:
     }
     
     /*@return Read/write map containing the footprint*/
-    std::map<Price, Level, std::greater<Price>> &footprint(){
+    Footprint &footprint(){
         return _footprint;
     }
 
@@ -249,6 +256,53 @@ public:
         }
     }
 
+    /*Writes the candlestick in binary form. Smaller and much faster to read back than the text form used by ```operator<<```.
+    @param out output stream. Should be opened in binary mode
+    */
+    void write_bin(std::ostream &out) const {
+        uint32_t level_size = _footprint.size();
+        out.write(reinterpret_cast<const char *>(&_open), sizeof(Price));
+        out.write(reinterpret_cast<const char *>(&_high), sizeof(Price));
+        out.write(reinterpret_cast<const char *>(&_low), sizeof(Price));
+        out.write(reinterpret_cast<const char *>(&_close), sizeof(Price));
+        out.write(reinterpret_cast<const char *>(&_time_stamp), sizeof(time_t));
+        out.write(reinterpret_cast<const char *>(&level_size), sizeof(uint32_t));
+        for (auto &p : _footprint){
+            out.write(reinterpret_cast<const char *>(&p.second.price), sizeof(Price));
+            out.write(reinterpret_cast<const char *>(&p.second.bids), sizeof(Quantity));
+            out.write(reinterpret_cast<const char *>(&p.second.asks), sizeof(Quantity));
+        }
+    }
+
+    /*Reads a candlestick written by write_bin().
+    @param in input stream. Should be opened in binary mode
+    @return true if a candlestick was read, false on end of stream
+    */
+    bool read_bin(std::istream &in){
+        uint32_t level_size = 0;
+        in.read(reinterpret_cast<char *>(&_open), sizeof(Price));
+        in.read(reinterpret_cast<char *>(&_high), sizeof(Price));
+        in.read(reinterpret_cast<char *>(&_low), sizeof(Price));
+        in.read(reinterpret_cast<char *>(&_close), sizeof(Price));
+        in.read(reinterpret_cast<char *>(&_time_stamp), sizeof(time_t));
+        in.read(reinterpret_cast<char *>(&level_size), sizeof(uint32_t));
+        if (!in) return false;
+
+        Level temp;
+        for (uint32_t i = 0; i < level_size; i++){
+            in.read(reinterpret_cast<char *>(&temp.price), sizeof(Price));
+            in.read(reinterpret_cast<char *>(&temp.bids), sizeof(Quantity));
+            in.read(reinterpret_cast<char *>(&temp.asks), sizeof(Quantity));
+            if (!in) return false; // Truncated
+            _footprint.emplace_hint(_footprint.end(), temp.price, temp);
+        }
+        if (level_size > 0){
+            _contains_fp = true;
+            _profile = std::shared_ptr<Profile>(new Profile);
+        }
+        return bool(in);
+    }
+
     friend std::ostream &operator<<(std::ostream &out, CandleStick &obj){
         out << obj._open << " " << obj._high << " " << obj._low << " " << obj._close << " " << obj._time_stamp << " " << obj._footprint.size();
         for (auto &p : obj._footprint){
@@ -282,7 +336,7 @@ public:
 private:
     Price _open, _high, _low, _close;
     time_t _time_stamp;
-    std::map<Price, Level, std::greater<Price>> _footprint;
+    Footprint _footprint;
     std::shared_ptr<Profile> _profile;
     bool _set_profile = false, _contains_fp = false;
 };
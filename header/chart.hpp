@@ -9,8 +9,11 @@ Swing = structure that contains information about swing points i.e swing high an
 #pragma once
 #include "candlestick.hpp"
 #include "defs.hpp"
+#include "scheduler.hpp"
 #include <filesystem>
 #include <cmath>
+#include <memory>
+#include <memory_resource>
 
 //Enum indicating the point of application of an indicator
 enum class Source{
@@ -29,6 +32,11 @@ struct Swing{
 /*Collection of CandleSticks
 @param candles vector of candles
 @note move is called on ```candle``` i.e the contents in ```candles``` are moved not copied to the chart object
+
+The footprints of the candles loaded or aggregated into a chart are allocated from an arena owned by the chart, and freed all at once
+with the arena when the chart is destroyed. A moved chart takes its arena along. The footprints of a copy are
+allocated from the default resource, like any copied candle.
+@note A candle moved out of the chart keeps using the arena, so it should not outlive the chart. Copy it to keep it longer
 */
 class Chart{
 public:
@@ -38,7 +46,34 @@ public:
         _candles = std::move(candles); 
     }
 
+    Chart(const Chart &other) : _candles(other._candles), _indicators(other._indicators), _cvd(other._cvd){}
+
+    Chart(Chart &&other) = default;
+
+    Chart &operator=(const Chart &other){
+        _candles = other._candles;
+        _indicators = other._indicators;
+        _cvd = other._cvd;
+        return *this;
+    }
+
+    Chart &operator=(Chart &&other){
+        auto arena = std::move(_arena); // Released after the candles using it
+        _candles = std::move(other._candles);
+        _indicators = std::move(other._indicators);
+        _cvd = other._cvd;
+        _arena = std::move(other._arena);
+        return *this;
+    }
+
     size_t size()const {return _candles.size();}
+
+    /*@return arena the footprints of the chart are allocated from. Candles built with it should stay in the chart
+    @note The arena is not thread safe*/
+    std::pmr::memory_resource *resource(){
+        if (!_arena) _arena = std::make_unique<std::pmr::monotonic_buffer_resource>();
+        return _arena.get();
+    }
     
     //Returns true if chart is empty
     bool empty(){return _candles.empty();}
@@ -56,13 +91,48 @@ public:
         if (!file) throw std::logic_error("cause = load() : File not opened. Incorrect file path or file does not exist\n");
         
         while (1){
-            CandleStick c;
+            CandleStick c(resource());
             file >> c;
             if (file.eof()) break;
 
             _candles.push_back(std::move(c));
         }
         file.close();
+        _extend_cvd();
+    }
+
+    /*Loads candlesticks stored in binary form by store_bin() to Chart object
+    @param file_path path to the .bin file containing the aggregated data
+    */
+    void load_bin(const char *file_path){
+        std::filesystem::path filepath = file_path;
+        if (filepath.extension() != ".bin") throw std::logic_error("cause = load_bin() : file name should end with .bin\n");
+        std::ifstream file(file_path, std::ios::in | std::ios::binary);
+        if (!file) throw std::logic_error("cause = load_bin() : File not opened. Incorrect file path or file does not exist\n");
+        read_bin(file);
+    }
+
+    /*Reads candlesticks in binary form from a stream until the end of the stream. See CandleStick::write_bin()
+    @param in input stream opened in binary mode
+    */
+    void read_bin(std::istream &in){
+        while (1){
+            CandleStick c(resource());
+            if (!c.read_bin(in)) break;
+            _candles.push_back(std::move(c));
+        }
+        _extend_cvd();
+    }
+
+    /*Stores the candlesticks in binary form. Loading it with load_bin() is much faster than load()
+    @param file_path path to the .bin file
+    */
+    void store_bin(const char *file_path) const {
+        std::filesystem::path filepath = file_path;
+        if (filepath.extension() != ".bin") throw std::logic_error("cause = store_bin() : file name should end with .bin\n");
+        std::ofstream file(file_path, std::ios::out | std::ios::binary);
+        if (!file) throw std::logic_error("cause = store_bin() : File not opened\n");
+        for (auto &c : _candles) c.write_bin(file);
     }
 
     /*Applies simple moving average indicator to the chart.
@@ -104,18 +174,29 @@ public:
         else if (Source::high == source) pre = "high";
         else if (Source::low == source) pre = "low";
         std::string name = "sma_" + pre + "_" + std::to_string(length);
-        size_t n = 1, rebalance = 0;
-        for (size_t i = 0; i < size(); i++){
+        const std::vector<Price> &mean = select_indicator(sma);
+        std::vector<Price> values(size());
+        tasks::parallel_for(0, size(), 1024, [&](size_t i){ // Every window is independent
+            size_t n = std::min(i+1, length), rebalance = i+1-n;
             double temp = 0; // temp = ∑(x- x̄)²
             for (size_t j = rebalance; j < n+rebalance; j++)
-                temp += pow(_select(_candles[j], source) - select_indicator(sma)[i], 2); // (x- x̄)²
-            _indicators[name].push_back(sqrt(temp/n));
-            if (n < length) n++;
-            else rebalance++;
-        }
+                temp += pow(_select(_candles[j], source) - mean[i], 2); // (x- x̄)²
+            values[i] = sqrt(temp/n);
+        });
+        std::vector<Price> &data = _indicators[name];
+        data.insert(data.end(), values.begin(), values.end());
         return name;
     }
 
+    /*Computes the profile (point of control, value area, vwap, volumes and deltas) of every candle with a footprint, on the threads of
+    tasks::global(). Profiles are otherwise computed the first time they are used, one candle at a time.
+    @note Copies of a candle share its profile. Build the profiles before copying the chart (e.g to backtests run in parallel), so
+    the copies only read them
+    */
+    void build_profiles(){
+        tasks::parallel_for(0, _candles.size(), 256, [this](size_t i){_candles[i].cot();});
+    }
+
     /* Applies your custom indicator to the chart
     @param name name of the indicator. It will be used to access your indicator
     @param data data of the indicator
@@ -126,11 +207,21 @@ public:
         _indicators[name] = data;
     }
 
+    /* Applies your custom indicator to the chart. Same as above, but the data is moved into the chart instead of copied
+    @param name name of the indicator. It will be used to access your indicator
+    @param data data of the indicator
+    */
+    void custom_indicator(const char *name, std::vector<Price> &&data){
+        if (data.size() != _candles.size()) throw std::logic_error("cause = custom_indicator() : Data of indicator not equal to length of data in chart\n");
+        _indicators[name] = std::move(data);
+    }
+
     /*Adds a candle to the end of the chart
     @param c candle to be added
     */
     void push_back(CandleStick &c){
         _candles.push_back(c);
+        _extend_cvd();
     }
 
     /*Adds a candle to the end of the chart
@@ -138,6 +229,62 @@ public:
     */
     void push_back(CandleStick &&c){
         _candles.push_back(std::move(c));
+        _extend_cvd();
+    }
+
+    /*Applies the cumulative volume delta i.e the sum of the deltas of the candles since the start of their session. Once applied, the
+    column is extended as candles are added with push_back(), load() or read_bin(), at O(1) per candle. Candles added through candles()
+    are included the next time the column is selected.
+    @param session length of a session in seconds e.g 24*60*60 resets every day. 0 never resets
+    @param offset start of the sessions in seconds after 00:00 UTC e.g 13*60*60 + 30*60 for sessions starting at 13:30 UTC
+    @return Name of the indicator i.e "cvd"
+    */
+    std::string apply_cvd(time_t session = 0, time_t offset = 0){
+        _cvd = _Cvd{true, session, offset, 0};
+        _indicators["cvd"].clear();
+        _extend_cvd();
+        return "cvd";
+    }
+
+    /*Finds divergences between price and the cumulative volume delta at swing points, in one pass over the chart. A swing high
+    (low) is a candle whose high (low) is strictly above (below) the highs (lows) of the strength candles on each side, so it is only
+    known strength candles later. When a swing high is known and its high is above the previous swing high while its cvd is below the
+    cvd of the previous swing high, there is a bearish divergence. A lower low with a higher cvd is a bullish divergence. Swings of
+    different sessions are not compared.
+    The divergences are marked with 1 (0 otherwise) on the candle where the swing becomes known, so the columns have no look ahead bias.
+    Call it again after candles are added. apply_cvd() should be called first
+    @param strength number of candles on each side of a swing
+    @return Names of the indicators i.e {"cvd_bull_div_<strength>", "cvd_bear_div_<strength>"}
+    */
+    std::pair<std::string, std::string> apply_cvd_divergence(size_t strength = 2){
+        if (!_cvd.on) throw std::logic_error("cause = apply_cvd_divergence() : apply_cvd() should be called first\n");
+        const std::vector<Price> &cvd = select_indicator("cvd");
+        const size_t n = _candles.size(), k = std::max<size_t>(1, strength);
+        std::vector<Price> bull(n, 0), bear(n, 0);
+        size_t last_high = SIZE_MAX, last_low = SIZE_MAX;
+        for (size_t i = 2*k; i < n; i++){
+            const size_t s = i-k; // Candidate swing, known on candle i
+            bool high = true, low = true;
+            for (size_t j = s-k; j <= i; j++){
+                if (j == s) continue;
+                high &= _candles[j].high() < _candles[s].high();
+                low &= _candles[j].low() > _candles[s].low();
+            }
+            if (high){
+                if (last_high != SIZE_MAX && _same_session(last_high, s) && _candles[s].high() > _candles[last_high].high()
+                    && cvd[s] < cvd[last_high]) bear[i] = 1;
+                last_high = s;
+            }
+            if (low){
+                if (last_low != SIZE_MAX && _same_session(last_low, s) && _candles[s].low() < _candles[last_low].low()
+                    && cvd[s] > cvd[last_low]) bull[i] = 1;
+                last_low = s;
+            }
+        }
+        std::string bull_name = "cvd_bull_div_" + std::to_string(k), bear_name = "cvd_bear_div_" + std::to_string(k);
+        _indicators[bull_name] = std::move(bull);
+        _indicators[bear_name] = std::move(bear);
+        return {bull_name, bear_name};
     }
 
     /*@brief selects an indicator
@@ -145,6 +292,7 @@ public:
     @param name name of the indicator
     */
     const std::vector<Price> &select_indicator(std::string name){
+        if (_cvd.on && name == "cvd") _extend_cvd();
         if (_indicators.find(name) == _indicators.end()) throw std::logic_error("cause = select_indicator() : Indicator does not exist\n");
         return _indicators[name];
     }
@@ -155,9 +303,36 @@ public:
     CandleStick &operator[](size_t id){return _candles[id];}
 
 private:
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> _arena; //Declared before _candles so it is destroyed after them
     std::vector<CandleStick> _candles;
     std::map<std::string, std::vector<Price>> _indicators;
 
+    //Settings and running sum of the cvd column. See apply_cvd()
+    struct _Cvd{
+        bool on = false;
+        time_t session = 0, offset = 0;
+        double sum = 0;
+    } _cvd;
+
+    //@return true if the candles i and j are in the same cvd session
+    bool _same_session(size_t i, size_t j) const {
+        if (_cvd.session == 0) return true;
+        return (_candles[i].timestamp()/1000 - _cvd.offset)/_cvd.session == (_candles[j].timestamp()/1000 - _cvd.offset)/_cvd.session;
+    }
+
+    //Adds the cvd of the candles that are not in the cvd column yet
+    void _extend_cvd(){
+        if (!_cvd.on) return;
+        std::vector<Price> &cvd = _indicators["cvd"];
+        for (size_t i = cvd.size(); i < _candles.size(); i++){
+            Quantity bids = 0, asks = 0; // Same as CandleStick::delta(), without building the profile
+            for (auto &p : _candles[i].footprint()) bids += p.second.bids, asks += p.second.asks;
+            if (i == 0 || !_same_session(i-1, i)) _cvd.sum = 0;
+            _cvd.sum += bids - asks;
+            cvd.push_back(_cvd.sum);
+        }
+    }
+
     /*@return Data corresponding to source*/
     Price _select(const CandleStick &x, const Source &source){        
         if (source == Source::open) return x.open();
@@ -8,6 +8,9 @@
 #include "rowdata.hpp"
 #include <chrono>
 #include <thread>
+#include <filesystem>
+#include <algorithm>
+#include <memory>
 
 namespace data{
     /*Class inheriting from std::fstream and incorporating RAII.
@@ -30,12 +33,54 @@ namespace data{
             open(__s, __mode);
             if (!is_open()) throw std::logic_error("cause = File::open_except() : No such file\n");
         }
+
+        /*
+        Reads from __buf instead of a file. The stream takes ownership of the buffer. See data::open_input()
+
+        @param __buf The stream buffer to read from e.g a buffer decompressing an archive.
+        */
+        void attach(std::unique_ptr<std::streambuf> __buf){
+            _source = std::move(__buf);
+            std::ios::rdbuf(_source.get());
+        }
+
+    private:
+        std::unique_ptr<std::streambuf> _source;
     };
     
+    namespace {
+        /*@brief Matches name against a wildcard pattern. '*' matches any sequence of characters and '?' matches one character*/
+        inline bool __match__(const char *pattern, const char *name){
+            if (*pattern == '\0') return *name == '\0';
+            if (*pattern == '*') return __match__(pattern+1, name) || (*name != '\0' && __match__(pattern, name+1));
+            if (*name == '\0') return false;
+            return (*pattern == '?' || *pattern == *name) && __match__(pattern+1, name+1);
+        }
+    }
+
+    /*@brief Lists the files matching a pattern. The wildcards '*' and '?' are only allowed in the file name.
+    e.g glob("data/BTCUSDT-trades-2024-*.csv")
+    @param pattern path with wildcards in the file name
+    @return paths of the matching files, sorted by name. Binance file names contain the date, so it is also the time order
+    */
+    inline std::vector<std::string> glob(const std::string &pattern){
+        std::filesystem::path p = pattern;
+        std::filesystem::path dir = p.has_parent_path() ? p.parent_path() : std::filesystem::path(".");
+        std::string name = p.filename().string();
+        std::vector<std::string> res;
+        for (auto &x : std::filesystem::directory_iterator(dir)){
+            if (x.is_regular_file() && __match__(name.c_str(), x.path().filename().string().c_str()))
+                res.push_back(x.path().string());
+        }
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+
     void thread_stream(SafeQueue<RowData> &buffer, FileStream &file,  RowData (*func) (data::FileStream &)){
 
         while (!file.eof()){
             RowData &&da = func(file);
+            if (file.fail()) break; // Nothing was read, the previous line was the last one
             buffer.push(da);
         }
     }    
@@ -1,31 +1,194 @@
 #pragma once
 #include "rowdata.hpp"
 #include "data.hpp"
+#include <charconv>
+#include <string_view>
+#include <utility>
+#include <bit>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
 
 /*A data handler is a function that reads a single line of csv parses the information and returns the information in a RowData format*/
 
 namespace handler{
-    inline RowData binance_handler(data::FileStream &file){
-        size_t n = 0;
-        static std::string line, col_content;
-        static RowData res;
-
-        std::getline(file, line);
-        for (const char &x : line){
-            if (x == ','){
-                /*Take a look at binance time and sales data and this block of code would make sense. 
-                This is essentially what varies with diffeent exchanges*/
-
-                if (n == 1)res.price = stof(col_content);
-                else if (n == 2)res.volume = stof(col_content);
-                else if (n == 4)res.timestamp = stoll(col_content); //In milliseconds
-                else if (n == 5)res.buyer_is_taker = col_content[0] == 'F' || col_content[0] == 'f';
-                n++;
-                col_content = "";
+
+    /*Field of RowData a column is parsed into*/
+    enum class Field{
+        price,
+        volume,
+        timestamp, // Unix time in milliseconds
+        timestamp_us, // Unix time in microseconds. It is converted to milliseconds
+        buyer_is_taker, // Boolean column, true means the buyer is the taker
+        buyer_is_maker // Boolean column, true means the buyer is the maker i.e the seller is the taker
+    };
+
+    /*Maps a column of the csv to a field of RowData. Columns that are not mapped are skipped.
+    @tparam Index position of the column, starting from 0
+    @tparam F field the column is parsed into
+    @note Boolean columns are true if they start with 't', 'T' or '1'
+    */
+    template <size_t Index, Field F>
+    struct Column{
+        static constexpr size_t index = Index;
+        static constexpr Field field = F;
+    };
+
+    namespace {
+
+        /*@brief Finds the first occurrence of delim in [first, last). Uses SSE2/AVX2 when it is available.
+        @return pointer to the delimiter, last if it is not found
+        */
+        inline const char *__find__(const char *first, const char *last, char delim){
+#if defined(__AVX2__)
+            const __m256i d32 = _mm256_set1_epi8(delim);
+            while (last-first >= 32){
+                unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) first), d32));
+                if (mask) return first + std::countr_zero(mask);
+                first += 32;
+            }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+            const __m128i d16 = _mm_set1_epi8(delim);
+            while (last-first >= 16){
+                unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) first), d16));
+                if (mask) return first + std::countr_zero(mask);
+                first += 16;
+            }
+#endif
+            while (first != last && *first != delim) ++first;
+            return first;
+        }
+
+        /*@brief Parses [first, last) into the field F of row
+        @return true if the column was parsed
+        */
+        template <Field F>
+        inline bool __set__(const char *first, const char *last, RowData &row){
+            if constexpr (F == Field::price) return std::from_chars(first, last, row.price).ec == std::errc();
+            else if constexpr (F == Field::volume) return std::from_chars(first, last, row.volume).ec == std::errc();
+            else if constexpr (F == Field::timestamp || F == Field::timestamp_us){
+                long long x = 0;
+                if (std::from_chars(first, last, x).ec != std::errc()) return false;
+                row.timestamp = (F == Field::timestamp) ? x : x/1000;
+                return true;
+            }
+            else {
+                if (first == last) return false;
+                bool x = *first == 't' || *first == 'T' || *first == '1';
+                row.buyer_is_taker = (F == Field::buyer_is_taker) ? x : !x;
+                return true;
             }
-            else col_content += x;
         }
-        col_content = ""; // Reset the col_content before appending to it, since it is static
+    }
+    //namespace end
+
+    /*Layout of a delimited time and sales file. The parser is generated at compile time: unmapped columns are only scanned for the
+    delimiter and each mapped column is parsed with std::from_chars directly into RowData, without allocating.
+    @tparam Delimiter column separator
+    @tparam Columns columns to parse. See Column
+    */
+    template <char Delimiter, typename... Columns>
+    struct Schema{
+        static constexpr char delimiter = Delimiter;
+        static constexpr size_t n_columns = std::max({Columns::index...}) + 1; // Number of columns that need to be scanned
+
+        /*@brief Parses a line into row
+        @param first start of the line
+        @param last end of the line, without the newline character
+        @param row row to be filled
+        @return true if all mapped columns were parsed
+        */
+        static bool parse(const char *first, const char *last, RowData &row){
+            if (first != last && last[-1] == '\r') --last;
+            return _parse(first, last, row, std::make_index_sequence<n_columns>());
+        }
+
+        static bool parse(std::string_view line, RowData &row){
+            return parse(line.data(), line.data()+line.size(), row);
+        }
+
+    private:
+        template <size_t... I>
+        static bool _parse(const char *first, const char *last, RowData &row, std::index_sequence<I...>){
+            return (_column<I>(first, last, row) && ...);
+        }
+
+        // Index of the field the I-th column is parsed into, -1 if it is skipped
+        template <size_t I>
+        static constexpr int _field_of(){
+            int f = -1;
+            ((Columns::index == I ? (f = (int) Columns::field) : 0), ...);
+            return f;
+        }
+
+        template <size_t I>
+        static bool _column(const char *&first, const char *last, RowData &row){
+            if (first > last) return false;
+            const char *end = __find__(first, last, Delimiter);
+            if constexpr (_field_of<I>() >= 0){
+                if (!__set__<(Field) _field_of<I>()>(first, end, row)) return false;
+            }
+            first = end+1;
+            return true;
+        }
+    };
+
+    /*Binance spot and futures trades: id,price,qty,quote_qty,time,is_buyer_maker[,is_best_match]*/
+    using binance_schema = Schema<',', Column<1, Field::price>, Column<2, Field::volume>, Column<4, Field::timestamp>, Column<5, Field::buyer_is_maker>>;
+    /*Binance spot trades with the time in microseconds (used from 2025)*/
+    using binance_us_schema = Schema<',', Column<1, Field::price>, Column<2, Field::volume>, Column<4, Field::timestamp_us>, Column<5, Field::buyer_is_maker>>;
+
+    /*A data handler generated from a Schema. It is thread safe, each thread reuses its own line buffer.
+    Empty lines are skipped. Throws if a line can't be parsed, e.g a header that wasn't skipped. At the end of the file nothing is read and
+    the stream fails
+    @tparam S schema of the file
+    */
+    template <typename S>
+    inline RowData schema_handler(data::FileStream &file){
+        thread_local std::string line;
+        RowData res{};
+        do {
+            if (!std::getline(file, line)) return res;
+        } while (line.empty() || line == "\r");
+        if (!S::parse(line, res)) throw std::logic_error("cause = schema_handler() : Line could not be parsed\n");
         return res;
     }
+
+    inline RowData binance_handler(data::FileStream &file){
+        return schema_handler<binance_schema>(file);
+    }
+
+    /*Size of a trade in binary form. See decode_binary()*/
+    constexpr size_t binary_size = 17;
+
+    /*Decodes a trade written in binary form by generator::write_bin(): timestamp (int64), price (float), volume (float) and
+    buyer_is_taker (uint8), little endian
+    @param buf binary_size bytes
+    */
+    inline RowData decode_binary(const char *buf){
+        RowData res{};
+        int64_t timestamp;
+        std::memcpy(&timestamp, buf, 8);
+        std::memcpy(&res.price, buf+8, 4);
+        std::memcpy(&res.volume, buf+12, 4);
+        res.timestamp = timestamp;
+        res.buyer_is_taker = buf[16];
+        return res;
+    }
+
+    /*Reads a trade written in binary form by generator::write_bin(). See decode_binary()
+    @note The file should end with .bin so it is opened in binary mode*/
+    inline RowData binary_handler(data::FileStream &file){
+        char buf[binary_size];
+        if (!file.read(buf, sizeof(buf))) return RowData{};
+        return decode_binary(buf);
+    }
 }
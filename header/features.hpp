@@ -0,0 +1,106 @@
+/*
+This file contains code to compute order flow features of every candle of a chart as indicator columns
+Feature = features that can be computed, combined with |
+FeatureConfig = features to compute and their parameters
+apply_features = computes the features and stores them in the chart
+*/
+#pragma once
+
+#include "defs.hpp"
+#include "candlestick.hpp"
+#include "chart.hpp"
+#include "scheduler.hpp"
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <limits>
+
+/*Order flow features of a candle. Each one is stored in a Chart indicator column named after it (with FeatureConfig::prefix).
+Candles without a footprint get NaN
+*/
+enum class Feature : uint32_t{
+    delta = 1 << 0, //"delta" : bids - asks, same as CandleStick::delta()
+    delta_pct = 1 << 1, //"delta_pct" : delta / volume, in [-1, 1]
+    poc_position = 1 << 2, //"poc_pos" : (poc - low) / (high - low) of the footprint, in [0, 1]. 0.5 if it has one level
+    volume_at_high = 1 << 3, //"vol_high" : volume of the edge highest levels
+    volume_at_low = 1 << 4, //"vol_low" : volume of the edge lowest levels
+    unfinished_high = 1 << 5, //"unfinished_high" : 1 if the highest level traded on both sides i.e the auction at the high is unfinished, 0 otherwise
+    unfinished_low = 1 << 6, //"unfinished_low" : 1 if the lowest level traded on both sides, 0 otherwise
+    absorption_high = 1 << 7, //"absorption_high" : bids of the edge highest levels / volume i.e the share of the volume bought at the high and absorbed by passive sellers
+    absorption_low = 1 << 8, //"absorption_low" : asks of the edge lowest levels / volume i.e the share of the volume sold at the low and absorbed by passive buyers
+    all = (1 << 9) - 1
+};
+
+constexpr Feature operator|(Feature x, Feature y){return (Feature) ((uint32_t) x | (uint32_t) y);}
+
+constexpr bool operator&(Feature x, Feature y){return ((uint32_t) x & (uint32_t) y) != 0;}
+
+/*Features to compute and their parameters
+@param features features to compute e.g Feature::delta | Feature::poc_position
+@param edge number of levels at the high and at the low used by volume_at_high/low and absorption_high/low
+@param prefix prefix of the names of the columns e.g "fp_" gives "fp_delta"
+*/
+struct FeatureConfig{
+    Feature features = Feature::all;
+    size_t edge = 1;
+    std::string prefix = "";
+};
+
+/*Computes footprint features of every candle of a chart in one pass over each footprint, on the threads of tasks::global(), and stores
+them as indicator columns of the chart (see Chart::select_indicator). Existing columns with the same names are replaced. Call it again
+after the candles change.
+@return names of the columns, in the order of Feature
+*/
+inline std::vector<std::string> apply_features(Chart &chart, const FeatureConfig &config = {}){
+    static const char *names[] = {"delta", "delta_pct", "poc_pos", "vol_high", "vol_low", "unfinished_high", "unfinished_low",
+        "absorption_high", "absorption_low"};
+    constexpr size_t n_features = sizeof(names)/sizeof(names[0]);
+    const size_t n = chart.size();
+    const Price nan = std::numeric_limits<Price>::quiet_NaN();
+    std::vector<Price> columns[n_features];
+    for (size_t k = 0; k < n_features; k++)
+        if (config.features & (Feature) (1u << k)) columns[k].assign(n, nan);
+    auto set = [&](size_t k, size_t c, Price x){if (!columns[k].empty()) columns[k][c] = x;};
+
+    std::vector<CandleStick> &candles = chart.candles();
+    const size_t edge = std::max<size_t>(1, config.edge);
+    tasks::parallel_for(0, n, 256, [&](size_t c){
+        Footprint &fp = candles[c].footprint();
+        if (fp.empty()) return;
+        Quantity bids = 0, asks = 0, max_vol = 0, high_vol = 0, low_vol = 0, high_bids = 0, low_asks = 0;
+        Price poc = fp.begin()->first;
+        const size_t levels = fp.size();
+        size_t i = 0;
+        for (auto &p : fp){ // Highest price first
+            const Level &x = p.second;
+            Quantity vol = x.bids + x.asks;
+            bids += x.bids, asks += x.asks;
+            if (vol > max_vol){ // Same point of control as Profile
+                max_vol = vol;
+                poc = p.first;
+            }
+            if (i < edge) high_vol += vol, high_bids += x.bids;
+            if (i+edge >= levels) low_vol += vol, low_asks += x.asks;
+            i++;
+        }
+        const Price high = fp.begin()->first, low = fp.rbegin()->first;
+        const Quantity volume = bids + asks, delta = bids - asks;
+        set(0, c, delta);
+        set(1, c, volume > 0 ? delta/volume : 0);
+        set(2, c, high > low ? (poc-low)/(high-low) : 0.5f);
+        set(3, c, high_vol);
+        set(4, c, low_vol);
+        set(5, c, fp.begin()->second.bids > 0 && fp.begin()->second.asks > 0);
+        set(6, c, fp.rbegin()->second.bids > 0 && fp.rbegin()->second.asks > 0);
+        set(7, c, volume > 0 ? high_bids/volume : 0);
+        set(8, c, volume > 0 ? low_asks/volume : 0);
+    });
+
+    std::vector<std::string> res;
+    for (size_t k = 0; k < n_features; k++){
+        if (columns[k].empty()) continue;
+        res.push_back(config.prefix + names[k]);
+        chart.custom_indicator(res.back().c_str(), std::move(columns[k]));
+    }
+    return res;
+}
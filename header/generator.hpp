@@ -0,0 +1,324 @@
+/*
+This file contains code to generate synthetic time and sales data, e.g for benchmarks and tests that should not depend on a local file.
+Config = parameters of the generated market
+TradeGenerator = generates the trades, one chunk at a time
+write_csv/ write_bin = write the trades in binance format/ in binary form using several threads
+
+The output only depends on the config and the number of rows, not on the number of threads. The data is generated in chunks of
+chunk_rows trades. The price at the start of each chunk comes from a coarse random walk, and the trades in between follow a random
+walk bridged to it, so every chunk can be generated independently.
+*/
+#pragma once
+
+#include "defs.hpp"
+#include "rowdata.hpp"
+#include "scheduler.hpp"
+#include <cmath>
+#include <cstdint>
+#include <charconv>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+
+namespace generator{
+
+    /*Parameters of the generated market
+    @param seed seed of the random numbers. The same seed gives the same data
+    @param start_time timestamp of the first trade in milliseconds
+    @param start_price price of the first trade
+    @param tick minimum price increment. Prices are rounded to it
+    @param trades_per_sec average number of trades per second
+    @param volatility standard deviation of the log return of a trade
+    @param burst_volatility volatility and trade rate multiplier during a burst
+    @param burst_probability probability of a burst starting at each trade
+    @param burst_length average number of trades in a burst
+    @param buy_ratio probability of a trade being a buy (buyer is taker)
+    @param persistence probability of a trade having the same side as the previous one, instead of a random side
+    @param mean_size mean trade size
+    @param size_sigma dispersion of the (log normal) trade size
+    @param lot minimum size increment. Sizes are rounded to it
+    @param round_size_probability probability of a trade size being rounded to one significant digit e.g 0.5, 2, 10
+    */
+    struct Config{
+        uint64_t seed = 1;
+        time_t start_time = 1'700'000'000'000;
+        double start_price = 30000;
+        double tick = 0.01;
+        double trades_per_sec = 20;
+        double volatility = 0.00005;
+        double burst_volatility = 4;
+        double burst_probability = 0.0005;
+        double burst_length = 2000;
+        double buy_ratio = 0.5;
+        double persistence = 0.6;
+        double mean_size = 0.05;
+        double size_sigma = 1.2;
+        double lot = 0.00001;
+        double round_size_probability = 0.3;
+    };
+
+    namespace {
+
+        inline uint64_t __splitmix64__(uint64_t &x){
+            uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+
+        /*xoshiro256** random number generator. Used instead of <random> because the output of the standard distributions
+        differs between standard libraries*/
+        class __Random__{
+        public:
+            __Random__(uint64_t seed, uint64_t stream){
+                uint64_t x = seed ^ (stream * 0xd1342543de82ef95ull);
+                for (auto &s : _s) s = __splitmix64__(x);
+            }
+
+            uint64_t next(){
+                const uint64_t res = _rotl(_s[1]*5, 7)*9, t = _s[1] << 17;
+                _s[2] ^= _s[0];
+                _s[3] ^= _s[1];
+                _s[1] ^= _s[2];
+                _s[0] ^= _s[3];
+                _s[2] ^= t;
+                _s[3] = _rotl(_s[3], 45);
+                return res;
+            }
+
+            //@return uniform number in (0, 1)
+            double uniform(){return ((next() >> 11) + 0.5) * 0x1.0p-53;}
+
+            //@return standard normal number
+            double normal(){
+                if (_has_spare){
+                    _has_spare = false;
+                    return _spare;
+                }
+                double r = std::sqrt(-2*std::log(uniform())), theta = 6.283185307179586*uniform();
+                _spare = r*std::sin(theta);
+                _has_spare = true;
+                return r*std::cos(theta);
+            }
+
+            //@return exponential number with a mean of 1
+            double exponential(){return -std::log(uniform());}
+
+        private:
+            uint64_t _s[4];
+            double _spare = 0;
+            bool _has_spare = false;
+
+            static uint64_t _rotl(uint64_t x, int k){return (x << k) | (x >> (64-k));}
+        };
+    }
+    //namespace end
+
+    /*Generates trades. The trades are split in chunks of chunk_rows trades that are generated independently
+    @param config parameters of the generated market
+    @param rows total number of trades
+    */
+    class TradeGenerator{
+    public:
+        static constexpr size_t chunk_rows = 1 << 16;
+
+        TradeGenerator(const Config &config, size_t rows) : _config(config), _rows(rows){
+            // Log price at the start of each chunk. It is a coarse random walk with one step per chunk
+            const Config &c = _config;
+            double mean_mult = 1 + c.burst_probability*c.burst_length*(c.burst_volatility*c.burst_volatility - 1);
+            double step = c.volatility*std::sqrt(chunk_rows*mean_mult);
+            __Random__ rng(c.seed, 0);
+            _anchors.resize(chunks()+1);
+            _anchors[0] = std::log(c.start_price);
+            for (size_t i = 1; i < _anchors.size(); i++) _anchors[i] = _anchors[i-1] + step*rng.normal();
+        }
+
+        //@return Number of chunks
+        size_t chunks() const {return (_rows + chunk_rows - 1)/chunk_rows;}
+
+        /*@brief Generates a chunk of trades. Thread safe
+        @param chunk index of the chunk
+        @param rows vector the trades are written to. It is cleared first
+        */
+        void chunk(size_t chunk, std::vector<RowData> &rows) const {
+            rows.clear();
+            if (chunk >= chunks()) return;
+            const size_t n = std::min(chunk_rows, _rows - chunk*chunk_rows);
+            const Config &c = _config;
+            __Random__ rng(c.seed, chunk+1);
+            const double start = _anchors[chunk], end = _anchors[chunk+1];
+            const double duration = chunk_rows/c.trades_per_sec*1000; // in milliseconds
+            const time_t start_time = c.start_time + (time_t) (chunk*duration);
+
+            // Random walk of the log price and of the time, bridged afterwards to the anchors of this chunk and the next
+            std::vector<double> walk(n+1), clock(n+1);
+            walk[0] = clock[0] = 0;
+            size_t burst = 0;
+            for (size_t i = 1; i <= n; i++){
+                if (burst == 0 && rng.uniform() < c.burst_probability) burst = 1 + (size_t) (rng.exponential()*c.burst_length);
+                double mult = burst > 0 ? c.burst_volatility : 1;
+                if (burst > 0) burst--;
+                walk[i] = walk[i-1] + c.volatility*mult*rng.normal();
+                clock[i] = clock[i-1] + rng.exponential()/mult;
+            }
+            // A full chunk ends where the next one starts
+            const double span = (double) n/chunk_rows, drift = (end-start)*span - walk[n];
+            const double time_scale = duration*span/(clock[n] + rng.exponential());
+
+            bool buy = rng.uniform() < c.buy_ratio;
+            rows.resize(n);
+            for (size_t i = 0; i < n; i++){
+                RowData &row = rows[i];
+                double log_price = start + walk[i] + drift*i/n;
+                row.price = std::round(std::exp(log_price)/c.tick)*c.tick;
+                row.timestamp = start_time + (time_t) (clock[i]*time_scale);
+
+                if (rng.uniform() >= c.persistence) buy = rng.uniform() < c.buy_ratio;
+                row.buyer_is_taker = buy;
+
+                double size = c.mean_size*std::exp(c.size_sigma*rng.normal() - c.size_sigma*c.size_sigma/2);
+                if (rng.uniform() < c.round_size_probability){
+                    double mag = std::pow(10, std::floor(std::log10(size)));
+                    size = std::round(size/mag)*mag;
+                }
+                row.volume = std::max(c.lot, std::round(size/c.lot)*c.lot);
+            }
+        }
+
+    private:
+        Config _config;
+        size_t _rows;
+        std::vector<double> _anchors;
+    };
+
+    namespace {
+
+        /*@brief Produces chunks with tasks of tasks::global() and consumes them in order on the calling thread. At most threads chunks
+        are produced at the same time, and tasks stay at most 2*threads chunks ahead of the consumer*/
+        template <typename Produce, typename Consume>
+        void __ordered__(size_t n, unsigned threads, Produce produce, Consume consume){
+            if (n == 0) return;
+            if (threads == 0) threads = tasks::global().threads();
+            const size_t window = 2*threads;
+            std::vector<std::string> results(n);
+            std::unique_ptr<std::atomic<bool>[]> ready(new std::atomic<bool>[n]);
+            for (size_t i = 0; i < n; i++) ready[i] = false;
+            tasks::TaskGroup group(tasks::global(), threads);
+            auto submit = [&](size_t i){
+                group.run([&, i](){
+                    thread_local std::vector<RowData> rows; // Reused by the chunks produced on the same thread
+                    produce(i, rows, results[i]);
+                    ready[i] = true;
+                });
+            };
+            for (size_t i = 0; i < std::min(n, window); i++) submit(i);
+
+            try {
+                for (size_t i = 0; i < n; i++){
+                    if (!group.wait_until([&](){return ready[i].load();})) break;
+                    std::string out = std::move(results[i]);
+                    if (i+window < n) submit(i+window);
+                    consume(out);
+                }
+                group.wait(); // Rethrows the exception of a chunk
+            }
+            catch (...) {
+                group.cancel();
+                throw;
+            }
+        }
+
+        inline void __append__(std::string &out, double x, int precision){
+            char buf[64];
+            out.append(buf, std::to_chars(buf, buf+sizeof(buf), x, std::chars_format::fixed, precision).ptr);
+        }
+
+        inline void __append__(std::string &out, long long x){
+            char buf[24];
+            out.append(buf, std::to_chars(buf, buf+sizeof(buf), x).ptr);
+        }
+
+        //@return number of decimals needed to print multiples of x
+        inline int __decimals__(double x){
+            int res = 0;
+            while (res < 10 && std::abs(x - std::round(x)) > 1e-9*std::max(1.0, x)){
+                x *= 10;
+                res++;
+            }
+            return res;
+        }
+    }
+    //namespace end
+
+    /*@brief Writes generated trades in binance spot format: id,price,qty,quote_qty,time,is_buyer_maker,is_best_match
+    Read it with handler::binance_handler.
+    @param path location of the file
+    @param rows number of trades
+    @param config parameters of the generated market
+    @param threads number of chunks generated at the same time. 0 uses the number of threads of tasks::global()
+    @return number of bytes written
+    */
+    inline size_t write_csv(const std::string &path, size_t rows, const Config &config = {}, unsigned threads = 0){
+        std::ofstream file(path, std::ios::out | std::ios::binary);
+        if (!file) throw std::logic_error("cause = write_csv() : File not opened\n");
+        TradeGenerator gen(config, rows);
+        const int price_decimals = __decimals__(config.tick), size_decimals = __decimals__(config.lot);
+        size_t bytes = 0;
+
+        __ordered__(gen.chunks(), threads, [&](size_t c, std::vector<RowData> &data, std::string &out){
+            gen.chunk(c, data);
+            out.reserve(data.size()*72);
+            long long id = c*TradeGenerator::chunk_rows;
+            for (const RowData &row : data){
+                __append__(out, id++);
+                out += ',';
+                __append__(out, row.price, price_decimals);
+                out += ',';
+                __append__(out, row.volume, size_decimals);
+                out += ',';
+                __append__(out, (double) row.price*row.volume, price_decimals + size_decimals);
+                out += ',';
+                __append__(out, (long long) row.timestamp);
+                out += row.buyer_is_taker ? ",false,true\n" : ",true,true\n";
+            }
+        }, [&](std::string &out){
+            file.write(out.data(), out.size());
+            bytes += out.size();
+        });
+        return bytes;
+    }
+
+    /*@brief Writes generated trades in binary form. Each trade is timestamp (int64), price (float), volume (float) and
+    buyer_is_taker (uint8), little endian. Read it with handler::binary_handler.
+    @param path location of the file. It should end with .bin
+    @param rows number of trades
+    @param config parameters of the generated market
+    @param threads number of chunks generated at the same time. 0 uses the number of threads of tasks::global()
+    @return number of bytes written
+    */
+    inline size_t write_bin(const std::string &path, size_t rows, const Config &config = {}, unsigned threads = 0){
+        std::ofstream file(path, std::ios::out | std::ios::binary);
+        if (!file) throw std::logic_error("cause = write_bin() : File not opened\n");
+        TradeGenerator gen(config, rows);
+        size_t bytes = 0;
+
+        __ordered__(gen.chunks(), threads, [&](size_t c, std::vector<RowData> &data, std::string &out){
+            gen.chunk(c, data);
+            out.resize(data.size()*17);
+            char *p = out.data();
+            for (const RowData &row : data){
+                int64_t timestamp = row.timestamp;
+                std::memcpy(p, &timestamp, 8);
+                std::memcpy(p+8, &row.price, 4);
+                std::memcpy(p+12, &row.volume, 4);
+                p[16] = row.buyer_is_taker;
+                p += 17;
+            }
+        }, [&](std::string &out){
+            file.write(out.data(), out.size());
+            bytes += out.size();
+        });
+        return bytes;
+    }
+}
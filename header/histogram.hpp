@@ -0,0 +1,98 @@
+/*
+This file contains a latency histogram with a bounded relative error, in the style of HdrHistogram
+LatencyHistogram = records durations in nanoseconds and reports percentiles
+*/
+#pragma once
+
+#include "defs.hpp"
+#include <cstdint>
+#include <bit>
+#include <limits>
+#include <string>
+#include <algorithm>
+
+/*Histogram of durations in nanoseconds. Values below 64 ns are recorded exactly, larger values in buckets of at most 1/32 (~3%)
+of their value. Recording is a few instructions and never allocates.
+*/
+class LatencyHistogram{
+public:
+    LatencyHistogram() = default;
+
+    //Records a duration in nanoseconds
+    void record(uint64_t ns){
+        _counts[_index(ns)]++;
+        _count++;
+        _sum += ns;
+        if (ns < _min) _min = ns;
+        if (ns > _max) _max = ns;
+    }
+
+    //Adds the values recorded in another histogram
+    void merge(const LatencyHistogram &other){
+        for (size_t i = 0; i < _buckets; i++) _counts[i] += other._counts[i];
+        _count += other._count;
+        _sum += other._sum;
+        _min = std::min(_min, other._min);
+        _max = std::max(_max, other._max);
+    }
+
+    void reset(){*this = LatencyHistogram();}
+
+    //@return number of values recorded
+    uint64_t count() const {return _count;}
+
+    uint64_t min() const {return _count > 0 ? _min : 0;}
+
+    uint64_t max() const {return _max;}
+
+    double mean() const {return _count > 0 ? (double) _sum/_count : 0;}
+
+    /*@return value at the percentile p. It is the upper bound of the bucket containing the value, capped by max()
+    @param p percentile in ratio e.g 0.99 instead of 99%
+    */
+    uint64_t percentile(double p) const {
+        if (_count == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, (uint64_t) (p*_count + 0.5)), seen = 0;
+        for (size_t i = 0; i < _buckets; i++){
+            seen += _counts[i];
+            if (seen >= rank) return std::min(_upper(i), _max);
+        }
+        return _max;
+    }
+
+    /*@return count, min, mean, percentiles and max as a JSON object. Values are in nanoseconds*/
+    std::string json() const {
+        return "{\"count\": " + std::to_string(count()) + ", \"min_ns\": " + std::to_string(min()) + ", \"mean_ns\": " + std::to_string(mean())
+        + ", \"p50_ns\": " + std::to_string(percentile(0.5)) + ", \"p90_ns\": " + std::to_string(percentile(0.9)) + ", \"p99_ns\": "
+        + std::to_string(percentile(0.99)) + ", \"p999_ns\": " + std::to_string(percentile(0.999)) + ", \"max_ns\": " + std::to_string(max()) + "}";
+    }
+
+    friend std::ostream &operator<<(std::ostream &out, const LatencyHistogram &obj){
+        out << "count : " << obj.count() << "\tmin : " << obj.min() << " ns\tmean : " << obj.mean() << " ns\tp50 : " << obj.percentile(0.5)
+        << " ns\tp90 : " << obj.percentile(0.9) << " ns\tp99 : " << obj.percentile(0.99) << " ns\tp99.9 : " << obj.percentile(0.999)
+        << " ns\tmax : " << obj.max() << " ns";
+        return out;
+    }
+
+private:
+    static constexpr int _sub_bits = 5;
+    static constexpr size_t _sub = 1 << _sub_bits;
+    static constexpr size_t _buckets = (65 - _sub_bits) * _sub;
+
+    uint64_t _counts[_buckets] = {};
+    uint64_t _count = 0, _sum = 0, _min = std::numeric_limits<uint64_t>::max(), _max = 0;
+
+    static size_t _index(uint64_t v){
+        if (v < 2*_sub) return v;
+        int shift = std::bit_width(v) - 1 - _sub_bits;
+        return shift*_sub + (v >> shift);
+    }
+
+    //@return largest value of the bucket
+    static uint64_t _upper(size_t i){
+        if (i < 2*_sub) return i;
+        int shift = i/_sub - 1;
+        uint64_t lower = (uint64_t) (i - shift*_sub) << shift;
+        return lower + ((uint64_t) 1 << shift) - 1;
+    }
+};
@@ -0,0 +1,229 @@
+/*
+This file contains the imbalances of the footprints of a chart, precomputed as bitsets
+Imbalance = kind of imbalance i.e horizontal or diagonal, buy or sell
+StackedImbalance = run of consecutive levels with the same kind of imbalance
+ImbalanceIndex = imbalance bitsets of every candle of a chart, with stacked imbalance queries
+
+A footprint is laid out on a dense grid of levels from its highest price down to its lowest, with a step of the price interval it was
+aggregated with. Level i is the i-th level from the top, like the order of Footprint. Prices without trades are levels with no volume,
+they never have an imbalance, so they end a stack.
+
+bids = aggressive buyers and asks = aggressive sellers (see NOTE in README). At a ratio r, level i has a
+    buy imbalance if bids[i] > r*asks[i] (same as Level::buy_imbalance)
+    sell imbalance if asks[i] > r*bids[i] (same as Level::sell_imbalance)
+    diagonal buy imbalance if bids[i] > r*asks[i+1] i.e buyers lifting a price against the sellers one level below
+    diagonal sell imbalance if asks[i] > r*bids[i-1] i.e sellers hitting a price against the buyers one level above
+The lowest level has no diagonal buy imbalance and the highest no diagonal sell imbalance.
+*/
+#pragma once
+
+#include "defs.hpp"
+#include "candlestick.hpp"
+#include "chart.hpp"
+#include "scheduler.hpp"
+#include <vector>
+#include <cstdint>
+#include <bit>
+#include <span>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+//Kind of imbalance. See imbalance.hpp
+enum class Imbalance : uint8_t{
+    buy,
+    sell,
+    diagonal_buy,
+    diagonal_sell
+};
+
+/*Consecutive levels of a candle with the same kind of imbalance*/
+struct StackedImbalance{
+    Price high; //Price of the highest level
+    Price low; //Price of the lowest level
+    size_t levels; //Number of levels
+};
+
+/*Imbalances of every level of every candle of a chart, stored as 4 bitsets per candle (one per kind of Imbalance). The longest stack of
+each kind is kept per candle, so finding the candles with n or more stacked imbalances is a comparison per candle packed into a bitset,
+and the bitsets of several queries can be combined with & and |.
+@param candles candles of the chart. The index should be rebuilt if they change
+@param price_level_interval the price difference between each price level, the one the chart was aggregated with
+@param ratio minimum ratio between the volumes compared, e.g 3 = 300%
+*/
+class ImbalanceIndex{
+public:
+    ImbalanceIndex() = default;
+
+    ImbalanceIndex(Chart &chart, Price price_level_interval, double ratio = 3){
+        build(chart.candles(), price_level_interval, ratio);
+    }
+
+    ImbalanceIndex(std::vector<CandleStick> &candles, Price price_level_interval, double ratio = 3){
+        build(candles, price_level_interval, ratio);
+    }
+
+    /*Computes the imbalances of every candle. The footprints are copied to dense arrays and compared in branch free loops, on the
+    threads of tasks::global()
+    */
+    void build(std::vector<CandleStick> &candles, Price price_level_interval, double ratio = 3){
+        if (!(price_level_interval > 0)) throw std::logic_error("cause = ImbalanceIndex::build() : price_level_interval should be positive\n");
+        const size_t n = candles.size();
+        _ratio = ratio;
+        _info.assign(n, {});
+        for (auto &x : _longest) x.assign(n, 0);
+        size_t words = 0;
+        for (size_t c = 0; c < n; c++){
+            _Info &info = _info[c];
+            Footprint &fp = candles[c].footprint();
+            if (fp.empty()) continue;
+            info.top = fp.begin()->first;
+            info.gap = price_level_interval;
+            info.levels = std::lround((info.top-fp.rbegin()->first)/info.gap)+1;
+            info.offset = words;
+            words += 4*_words(info.levels);
+        }
+        _bits.assign(words, 0);
+        tasks::parallel_for(0, n, 64, [&](size_t c){
+            thread_local std::vector<Quantity> bids, asks;
+            thread_local std::vector<uint8_t> flags;
+            const _Info &info = _info[c];
+            if (info.levels == 0) return;
+            const size_t m = info.levels;
+            bids.assign(m+2, 0), asks.assign(m+2, 0); //Padded by one empty level above and below
+            for (auto &p : candles[c].footprint()){
+                size_t i = _level(info, p.first);
+                bids[i+1] = p.second.bids;
+                asks[i+1] = p.second.asks;
+            }
+            flags.resize(m);
+            const Quantity *b = bids.data()+1, *a = asks.data()+1;
+            for (size_t k = 0; k < 4; k++){
+                switch ((Imbalance) k){
+                    case Imbalance::buy: for (size_t i = 0; i < m; i++) flags[i] = b[i] > ratio*a[i]; break;
+                    case Imbalance::sell: for (size_t i = 0; i < m; i++) flags[i] = a[i] > ratio*b[i]; break;
+                    case Imbalance::diagonal_buy: for (size_t i = 0; i < m; i++) flags[i] = b[i] > ratio*a[i+1]; flags[m-1] = 0; break;
+                    case Imbalance::diagonal_sell: for (size_t i = 0; i < m; i++) flags[i] = a[i] > ratio*b[i-1]; flags[0] = 0; break;
+                }
+                uint64_t *out = _bits.data() + info.offset + k*_words(m);
+                for (size_t i = 0; i < m; i++) out[i >> 6] |= (uint64_t) flags[i] << (i & 63);
+                _longest[k][c] = (uint32_t) _longest_run(out, _words(m));
+            }
+        });
+    }
+
+    //@return number of candles
+    size_t size() const {return _info.size();}
+
+    //@return ratio the imbalances were computed with
+    double ratio() const {return _ratio;}
+
+    //@return number of levels of the dense grid of a candle. 0 if it has no footprint
+    size_t levels(size_t candle) const {return _info[candle].levels;}
+
+    //@return price of a level of a candle. Level 0 is the highest price
+    Price price(size_t candle, size_t level) const {return _info[candle].top - level*_info[candle].gap;}
+
+    //@return bitset of the levels of a candle with an imbalance. Bit i%64 of word i/64 is level i
+    std::span<const uint64_t> bits(size_t candle, Imbalance kind) const {
+        const _Info &info = _info[candle];
+        size_t words = _words(info.levels);
+        return std::span<const uint64_t>(_bits.data() + info.offset + (size_t) kind*words, words);
+    }
+
+    //@return true if a level of a candle has an imbalance
+    bool test(size_t candle, Imbalance kind, size_t level) const {
+        return (bits(candle, kind)[level >> 6] >> (level & 63)) & 1;
+    }
+
+    //@return number of levels of a candle with an imbalance
+    size_t count(size_t candle, Imbalance kind) const {
+        size_t res = 0;
+        for (uint64_t w : bits(candle, kind)) res += std::popcount(w);
+        return res;
+    }
+
+    //@return number of levels of the longest stack of imbalances of a candle
+    size_t longest(size_t candle, Imbalance kind) const {return _longest[(size_t) kind][candle];}
+
+    //@return true if a candle has at least n stacked imbalances
+    bool stacked(size_t candle, Imbalance kind, size_t n) const {return longest(candle, kind) >= n;}
+
+    //@return the stacks of at least n imbalances of a candle, from the highest to the lowest
+    std::vector<StackedImbalance> stacks(size_t candle, Imbalance kind, size_t n) const {
+        std::vector<StackedImbalance> res;
+        const size_t m = _info[candle].levels;
+        auto b = bits(candle, kind);
+        for (size_t i = 0; i < m;){
+            if (!((b[i >> 6] >> (i & 63)) & 1)){
+                i++;
+                continue;
+            }
+            size_t j = i;
+            while (j < m && ((b[j >> 6] >> (j & 63)) & 1)) j++;
+            if (j-i >= n) res.push_back(StackedImbalance{price(candle, i), price(candle, j-1), j-i});
+            i = j;
+        }
+        return res;
+    }
+
+    /*@return bitset of the candles with at least n stacked imbalances. Bit i%64 of word i/64 is candle i, e.g
+    auto x = index.stacked_candles(Imbalance::buy, 3), y = index.stacked_candles(Imbalance::diagonal_buy, 3);
+    for (size_t w = 0; w < x.size(); w++) x[w] &= y[w]; // Candles with both
+    */
+    std::vector<uint64_t> stacked_candles(Imbalance kind, size_t n) const {
+        const std::vector<uint32_t> &longest = _longest[(size_t) kind];
+        std::vector<uint64_t> res(_words(longest.size()), 0);
+        for (size_t c = 0; c < longest.size(); c++) res[c >> 6] |= (uint64_t) (longest[c] >= n) << (c & 63);
+        return res;
+    }
+
+    //@return indexes of the candles with at least n stacked imbalances, in order
+    std::vector<size_t> find_stacked(Imbalance kind, size_t n) const {
+        std::vector<size_t> res;
+        std::vector<uint64_t> set = stacked_candles(kind, n);
+        for (size_t w = 0; w < set.size(); w++){
+            for (uint64_t x = set[w]; x != 0; x &= x-1) res.push_back(w*64 + std::countr_zero(x));
+        }
+        return res;
+    }
+
+private:
+    struct _Info{
+        Price top = 0; //Highest price
+        Price gap = 0; //Price interval between levels
+        size_t levels = 0;
+        size_t offset = 0; //First word of the bitsets in _bits
+    };
+
+    double _ratio = 3;
+    std::vector<_Info> _info;
+    std::vector<uint64_t> _bits;
+    std::vector<uint32_t> _longest[4];
+
+    static size_t _words(size_t bits){return (bits+63)/64;}
+
+    static size_t _level(const _Info &info, Price price){
+        return std::lround((info.top-price)/info.gap);
+    }
+
+    //@return length of the longest run of set bits
+    static size_t _longest_run(const uint64_t *words, size_t n){
+        size_t best = 0, run = 0;
+        for (size_t k = 0; k < n; k++){
+            const uint64_t x = words[k];
+            int pos = 0;
+            while (pos < 64){
+                int ones = std::countr_one(x >> pos);
+                run += ones, pos += ones;
+                best = std::max(best, run);
+                if (pos >= 64) break; //The run may go on in the next word
+                uint64_t rest = x >> pos;
+                run = 0;
+                if (rest == 0) break;
+                pos += std::countr_zero(rest);
+            }
+        }
+        return best;
+    }
+};
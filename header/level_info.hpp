@@ -4,6 +4,8 @@ This file contains code that describes the market level.
 */ 
 #pragma once
 #include "defs.hpp"
+#include <map>
+#include <memory_resource>
 
 /*A structure that contains information about the bid and ask volumes traded at a price*/
 struct Level{
@@ -42,3 +44,7 @@ struct Level{
 
 };
 
+/*Footprint of a candle i.e the levels sorted by price in descending order. Its nodes come from a memory resource, so the footprints of
+a chart can be allocated from one arena (see Chart::resource()). A default constructed footprint uses the global allocator
+*/
+using Footprint = std::pmr::map<Price, Level, std::greater<Price>>;
@@ -0,0 +1,296 @@
+/*
+This file contains code to run a strategy on trades received live, e.g from a recorder or a replay process (see replay.hpp)
+Csv/ Binary = wire formats of the trades
+Input = bytes read from stdin, a named pipe, a file or a unix socket
+Output = order sink writing the orders as lines of text
+Runtime = aggregates the trades into a chart and runs the strategy of a BasicBackTest on each candle close, and on each trade
+
+The strategy is the same code as in a backtest. The engine paper trades the orders on the candles (see BasicBackTest::step()), and
+BasicBackTest::order_sink receives every order the strategy adds. A strategy object can also have an on_trade(engine, row) member
+function, called on every trade after the candle it closes (if any) has been run.
+
+Trades are decoded in place from the input buffer and aggregated into footprints allocated from the arena of the chart, so the path from
+a trade to the decision of the strategy does not allocate in the steady state.
+@note Only available on POSIX systems
+*/
+#pragma once
+
+#include "defs.hpp"
+#include "rowdata.hpp"
+#include "datahandler.hpp"
+#include "aggregator.hpp"
+#include "backtest.hpp"
+#include "histogram.hpp"
+#include <chrono>
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace live{
+
+    /*Trades as lines of delimited text, parsed with a handler::Schema. Lines that can't be parsed (e.g a header) are skipped
+    @tparam S schema of a line
+    */
+    template <typename S>
+    struct Csv{
+        /*@brief Decodes the trade starting at first
+        @param valid set to false if the line couldn't be parsed
+        @return end of the trade, nullptr if [first, last) doesn't contain a whole line yet
+        */
+        static const char *decode(const char *first, const char *last, RowData &row, bool &valid){
+            const char *end = (const char *) std::memchr(first, '\n', last-first);
+            if (!end) return nullptr;
+            row = RowData{};
+            valid = S::parse(first, end, row);
+            return end+1;
+        }
+    };
+
+    /*Trades in the binary form of generator::write_bin() i.e handler::binary_size bytes each. See handler::decode_binary()*/
+    struct Binary{
+        static const char *decode(const char *first, const char *last, RowData &row, bool &valid){
+            if ((size_t) (last-first) < handler::binary_size) return nullptr;
+            row = handler::decode_binary(first);
+            valid = true;
+            return first + handler::binary_size;
+        }
+    };
+
+    /*Bytes read from a file descriptor. The buffer is allocated once, the bytes of a trade that is not complete yet are moved to its
+    front before the next read.
+    @param fd file descriptor e.g STDIN_FILENO
+    @param owned true if the input should close fd
+    @param capacity size of the buffer. Should be larger than a trade
+    */
+    class Input{
+    public:
+        explicit Input(int fd, bool owned = false, size_t capacity = 1 << 16) : _fd(fd), _owned(owned), _capacity(capacity),
+        _buffer(new char[capacity]){}
+
+        Input(Input &&other) noexcept : _fd(other._fd), _owned(other._owned), _capacity(other._capacity), _buffer(std::move(other._buffer)),
+        _begin(other._begin), _end(other._end){
+            other._owned = false;
+        }
+
+        Input(const Input &) = delete;
+
+        Input &operator=(const Input &) = delete;
+
+        ~Input(){
+            if (_owned) ::close(_fd);
+        }
+
+        /*Waits for bytes and appends them to the buffer
+        @return false at the end of the stream
+        */
+        bool fill(){
+            if (_begin > 0){
+                std::memmove(_buffer.get(), _buffer.get()+_begin, _end-_begin);
+                _end -= _begin;
+                _begin = 0;
+            }
+            if (_end == _capacity) throw std::logic_error("cause = Input::fill() : a trade is larger than the buffer\n");
+            while (true){
+                ssize_t n = ::read(_fd, _buffer.get()+_end, _capacity-_end);
+                if (n > 0){
+                    _end += n;
+                    return true;
+                }
+                if (n == 0) return false;
+                if (errno != EINTR) throw std::logic_error("cause = Input::fill() : read failed\n");
+            }
+        }
+
+        //@return bytes not consumed yet
+        const char *begin() const {return _buffer.get()+_begin;}
+
+        const char *end() const {return _buffer.get()+_end;}
+
+        //Drops the bytes before p, which should be in [begin(), end()]
+        void consume(const char *p){_begin = p - _buffer.get();}
+
+        int fd() const {return _fd;}
+
+    private:
+        int _fd;
+        bool _owned;
+        size_t _capacity;
+        std::unique_ptr<char[]> _buffer;
+        size_t _begin = 0, _end = 0;
+    };
+
+    //@return input reading the standard input
+    inline Input open_stdin(){
+        return Input(STDIN_FILENO);
+    }
+
+    /*@return input reading a file or a named pipe (see mkfifo). Opening a pipe waits for a writer
+    @param path path of the file*/
+    inline Input open_file(const std::string &path){
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::logic_error("cause = open_file() : No such file\n");
+        return Input(fd, true);
+    }
+
+    /*@return input reading a unix stream socket the feed is listening on
+    @param path path of the socket*/
+    inline Input connect_unix(const std::string &path){
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) throw std::logic_error("cause = connect_unix() : path is too long\n");
+        std::memcpy(addr.sun_path, path.c_str(), path.size()+1);
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) throw std::logic_error("cause = connect_unix() : socket() failed\n");
+        if (::connect(fd, (const sockaddr *) &addr, sizeof(addr)) != 0){
+            ::close(fd);
+            throw std::logic_error("cause = connect_unix() : connection refused\n");
+        }
+        return Input(fd, true);
+    }
+
+    /*Order sink writing each order as a line "timestamp,direction,type,entry,sl,tp,tag" to a file descriptor, e.g the standard output
+    or a socket of an execution process. direction is buy or sell and type is market or limit. A line is formatted in a fixed buffer
+    and written with one call
+    @param fd file descriptor
+    */
+    class Output{
+    public:
+        explicit Output(int fd = STDOUT_FILENO) : _fd(fd){}
+
+        //Writes an order. @param timestamp time of the candle the order is added on
+        void write(const Order &order, time_t timestamp){
+            char buf[160], *p = buf, *end = buf+sizeof(buf);
+            p = _field(p, end, (long long) timestamp, ',');
+            p = _text(p, order.direction == Direction::buy ? "buy," : "sell,");
+            p = _text(p, order.order_type == OrderType::market_order ? "market," : "limit,");
+            p = _field(p, end, order.entry, ',');
+            p = _field(p, end, order.sl, ',');
+            p = _field(p, end, order.tp, ',');
+            p = _field(p, end, (unsigned long long) order.tag, '\n');
+            for (const char *q = buf; q < p;){
+                ssize_t n = ::write(_fd, q, p-q);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) throw std::logic_error("cause = Output::write() : write failed\n");
+                q += n;
+            }
+        }
+
+    private:
+        int _fd;
+
+        //Writes a number followed by a separator. The buffer is large enough for every field
+        template <typename T>
+        static char *_field(char *p, char *end, T x, char sep){
+            p = std::to_chars(p, end-1, x).ptr;
+            *p = sep;
+            return p+1;
+        }
+
+        static char *_text(char *p, const char *s){
+            size_t n = std::strlen(s);
+            std::memcpy(p, s, n);
+            return p+n;
+        }
+    };
+
+    /*Runs the strategy of a backtest engine on trades received live. Each trade is aggregated into the chart of the engine (see
+    aggregator::Builder). When a trade closes a candle, the engine runs the strategy on it with step(). Then the strategy's
+    on_trade(engine, row), if it has one, is called with the trade once the engine has run on at least one candle.
+    The candles already in the chart of the engine (e.g history to warm up the strategy) are run by the constructor.
+
+    The time from the decoding of a trade to the end of the decision on it is recorded in trade_latency(), and in candle_latency() for
+    the trades that closed a candle.
+    @param engine engine whose chart the candles are added to. Should outlive the runtime
+    @param price_level_interval the price difference between each price level
+    @param time_interval time interval (in seconds)
+    @tparam Engine a BasicBackTest
+    @tparam Format wire format e.g Binary or Csv<handler::binance_schema>
+    */
+    template <typename Engine, typename Format = Binary>
+    class Runtime{
+    public:
+        Runtime(Engine &engine, const Price price_level_interval, const int time_interval) : _engine(engine),
+        _builder(engine.chart(), price_level_interval, time_interval){
+            _engine.chart().candles().reserve(_engine.chart().size() + (1 << 16));
+            _engine.start();
+            while (_engine.step());
+        }
+
+        /*Processes a trade
+        @param received time the trade was received, the start of the latencies
+        */
+        void on_row(const RowData &row, std::chrono::steady_clock::time_point received){
+            bool closed = _builder.add(row);
+            if (closed){
+                std::vector<CandleStick> &candles = _engine.chart().candles();
+                if (candles.size() == candles.capacity()) candles.reserve(2*candles.size()); // Grows before the hot path needs it
+                while (_engine.step());
+            }
+            if constexpr (requires(typename Engine::strategy_type &s, Engine &e, const RowData &r){ s.on_trade(e, r); }){
+                if (_engine.steps() > 0) _engine.strategy().on_trade(_engine, row);
+            }
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-received).count();
+            _trade_latency.record(ns);
+            if (closed) _candle_latency.record(ns);
+            _rows++;
+        }
+
+        void on_row(const RowData &row){on_row(row, std::chrono::steady_clock::now());}
+
+        /*Reads and processes trades until the end of the input
+        @return number of trades processed
+        */
+        size_t run(Input &in){
+            size_t start = _rows;
+            while (in.fill()){
+                const char *p = in.begin(), *end = in.end();
+                while (true){
+                    RowData row;
+                    bool valid;
+                    const char *next = Format::decode(p, end, row, valid);
+                    if (!next) break;
+                    p = next;
+                    if (valid) on_row(row, std::chrono::steady_clock::now());
+                }
+                in.consume(p);
+            }
+            return _rows-start;
+        }
+
+        /*Adds the candle being built to the chart and runs the strategy on it, e.g at the end of a replay so the candles are the same as
+        aggregate() gives
+        @return false if no candle was being built
+        */
+        bool flush(){
+            if (!_builder.flush()) return false;
+            while (_engine.step());
+            return true;
+        }
+
+        //@return the candle being built
+        const aggregator::Builder &builder() const {return _builder;}
+
+        //@return number of trades processed
+        size_t rows() const {return _rows;}
+
+        //@return time from receiving a trade to the end of the decision on it, in nanoseconds
+        const LatencyHistogram &trade_latency() const {return _trade_latency;}
+
+        //@return same as trade_latency(), for the trades that closed a candle
+        const LatencyHistogram &candle_latency() const {return _candle_latency;}
+
+    private:
+        Engine &_engine;
+        aggregator::Builder _builder;
+        LatencyHistogram _trade_latency, _candle_latency;
+        size_t _rows = 0;
+    };
+}
+//namespace end
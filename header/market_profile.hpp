@@ -16,7 +16,7 @@ class Profile {
     double _percent = 0.7;
 
     /*Calculates and sets information such as max_delta, bid volume, vwap etc*/
-    void _set_info(const std::map<Price, Level, std::greater<Price>> &footprint){
+    void _set_info(const Footprint &footprint){
         if (footprint.empty())return;
         double pv = 0; // pv = price * volume
 
@@ -55,13 +55,13 @@ class Profile {
     @param footprint footprint
     @param percentage Percentage of volume within the value area
     */
-    void _value_area(const std::map<Price, Level, std::greater<Price>> &footprint, double percentage){
+    void _value_area(const Footprint &footprint, double percentage){
         if (percentage > 1.0) percentage = 1.0;
         auto it = footprint.find(_cot);
         Quantity vol = it->second.asks + it->second.bids;
         const Quantity total_vol = volume();
-        std::map<Price, Level, std::greater<Price>>::const_iterator up;
-        std::map<Price, Level, std::greater<Price>>::const_iterator down;
+        Footprint::const_iterator up;
+        Footprint::const_iterator down;
         if (it == footprint.begin()){ 
             up = it;
             down = std::next(it);
@@ -109,7 +109,7 @@ class Profile {
 public:
     Profile() = default;
 
-    Profile(std::map<Price, Level, std::greater<Price>> &x, double va_percent = 0.7){
+    Profile(Footprint &x, double va_percent = 0.7){
         _percent = va_percent;
         _set_info(x);
     }
@@ -165,7 +165,8 @@ public:
     @param x footprint to be analyzed
     @param va_percent Percentage to calculated the value area. Defaults to 0.7 (70%)
     */
-    void set_fp(const std::map<Price, Level, std::greater<Price>> &x, double va_percent = 0.7){
+    void set_fp(const Footprint &x, double va_percent = 0.7){
+        *this = Profile(); // Recomputed from scratch, e.g by copies of a candle sharing the profile
         _percent = va_percent;
         _set_info(x);
     }
@@ -7,6 +7,8 @@ Trade = a structure that contains elements of a real life executed order
 #pragma once
 
 #include "defs.hpp"
+#include <string_view>
+#include <string>
 
 /*Indicates the direction of a trade/ order*/
 enum class Direction {
@@ -26,6 +28,7 @@ enum OrderType {
 @param timestamp time of entry
 @param direction direction of order, buy/sell
 @param comment additional information on order. For easy debugging
+@param tag number identifying the order e.g the index of the candle that triggered it. It is the same as Order::tag
 */
 struct Trade {
     Price entry; // entry price
@@ -34,9 +37,10 @@ struct Trade {
     time_t timestamp;
     Direction direction;
     /*Additional information about the trade for easy debugging e.g values of variables when the trade was taken. @note It would be the
-     same as Order::comment
+     same as Order::comment. It points into memory owned by the backtest engine and is valid until the next run
     */
-    std::string comment; 
+    std::string_view comment;
+    size_t tag = 0;
     bool success = false;
     bool trade_completed = false;
     float rr = 0; // reward-to-risk
@@ -51,18 +55,21 @@ Order is unexecuted. Not to be confused with Trade, it becomes a Trade when exec
 @param direction direction of order, buy/sell
 @param order_type type of order, market order/ limit order
 @param cancel_after maximum number of candles before cancelling if order is not triggered (for limit ordertype)
-@param comment additional information on order. For easy debugging
+@param comment additional information on order. For easy debugging. It is copied into the order, so a temporary string is fine
+@param tag number identifying the order. It is carried to the Trade and costs nothing, unlike a comment
 */
 struct Order{
 
     Order(Price _entry, Price _sl, Price _tp, Direction _direction, OrderType _order_type, size_t _cancel_after = SIZE_MAX,
-     std::string _comment = ""){
-        entry = _entry, sl = _sl, _tp = tp;
+     std::string_view _comment = "", size_t _tag = 0){
+        entry = _entry, sl = _sl, tp = _tp;
         direction = _direction;
         order_type = _order_type;
         cancel_after = _cancel_after;
-        comment = std::move(_comment);
+        comment = _comment;
+        tag = _tag;
     }
+
     Price entry;
     Price sl; // stop loss
     Price tp; // take profit
@@ -70,7 +77,10 @@ struct Order{
     OrderType order_type;
     // the number of candlestick it should wait for before cancelling. Only necessary for order_type = limit
     size_t cancel_after = SIZE_MAX; 
-    std::string comment; //Additional information about the order for easy debugging e.g values of variables when the order was placed
+    /*Additional information about the order for easy debugging e.g values of variables when the order was placed. The book copies it into
+    the comment of the trade when the order is filled*/
+    std::string comment;
+    size_t tag = 0; //Number identifying the order e.g the index of the candle that triggered it
     // current index when the order was placed. @note Should be left has it is
     size_t entry_id = 0;
     
@@ -0,0 +1,320 @@
+/*
+This file contains code to backtest a strategy on several instruments that share one account
+
+BasicPortfolio = a backtest engine that runs several charts in one event loop merged by timestamp
+Portfolio = BasicPortfolio using a function as the strategy
+*/
+
+#pragma once
+#include "defs.hpp"
+#include "candlestick.hpp"
+#include "chart.hpp"
+#include "order.hpp"
+#include "book.hpp"
+#include "backtest.hpp"
+#include "scheduler.hpp"
+#include <queue>
+#include <deque>
+#include <concepts>
+#include <type_traits>
+#include <algorithm>
+
+/*A portfolio strategy is either callable with the engine and the id of a symbol, or an object with an on_candle(engine, symbol) member function.
+It can also have an on_start(engine) member function, called at the start of every run*/
+template <typename Strategy, typename Engine>
+concept PortfolioStrategy = std::invocable<Strategy &, Engine &, size_t> || requires(Strategy &s, Engine &engine, size_t symbol){ s.on_candle(engine, symbol); };
+
+/*An object that backtests a strategy on several charts with one shared equity and drawdown.
+
+The candles of all the charts are merged by timestamp into steps. A step contains the candles of every symbol that has a candle at that
+timestamp. On each step the trades and limit orders of these symbols are checked (in parallel when threads > 1), the completed trades
+are applied to the equity in symbol order, then the strategy is called once per symbol in symbol order.
+@param strategy strategy to be backtested. Called with the id of the symbol whose candle closed
+@param strat_name name of the strategy
+@tparam Strategy type of the strategy. Defaults to FunctionStrategy i.e a function pointer void (*)(Portfolio &, size_t). See PortfolioStrategy
+*/
+template <typename Strategy = FunctionStrategy>
+class BasicPortfolio{
+
+    struct Symbol{
+        std::string name;
+        Chart *chart;
+        Book book;
+        size_t index = SIZE_MAX; //Index of the last candle reached. SIZE_MAX before the first candle
+        size_t aligned = 0; //Candles of the chart when the steps were built
+        size_t wins = 0;
+        size_t n_trades = 0;
+        float risk_reward = 0;
+    };
+
+    struct PerformanceMetric{
+        size_t long_wins = 0; //Number of profitable longs/buys
+        size_t short_wins = 0; //Number of profitable shorts/sells
+        size_t longs = 0; //Number of longs/buys
+        size_t shorts = 0; //Number of shorts/sells
+        size_t n_trades = 0; //Total number of trades
+        float risk_reward = 0; //Total reward to risk ratio
+        float returns = 0; //Current returns
+        std::chrono::milliseconds time_taken{0}; //Time taken for the backtest engine to complete the simulation
+    };
+
+public:
+    float risk = 0.01; //Risk per trade. It is not in percentage i.e 1% should be 0.01. @note Should not be negative
+    /*Number of threads checking the trades and orders of the symbols of a step, the calling thread and tasks of tasks::global().
+    1 runs everything on the calling thread.
+    @note Threads only pay off when the symbols have many open trades or pending orders, a step is short otherwise*/
+    size_t threads = 1;
+
+    //Type of the strategy stored in the engine
+    using strategy_type = std::conditional_t<std::is_same_v<Strategy, FunctionStrategy>, void (*) (BasicPortfolio &, size_t), Strategy>;
+
+    BasicPortfolio(strategy_type strategy, const char *strat_name = "") : _strategy(std::move(strategy)){
+        static_assert(PortfolioStrategy<strategy_type, BasicPortfolio>, "Strategy should be callable with the engine and a symbol or have on_candle(engine, symbol)");
+        _strategy_name = strat_name;
+    }
+
+    /*Adds a chart to the portfolio
+    @param name name of the symbol e.g BTCUSDT
+    @param chart chart of the symbol. @note It is not copied, it should outlive the portfolio
+    @return id of the symbol. Ids start at 0 in the order the symbols are added
+    */
+    size_t add_symbol(const std::string &name, Chart &chart){
+        _symbols.push_back(Symbol{name, &chart, Book(chart.candles())});
+        _steps = {};
+        return _symbols.size()-1;
+    }
+
+    /*Runs the backtest on the strategy. The candles of the charts are aligned again if a chart changed size since the last run*/
+    void run(){
+        auto start = std::chrono::high_resolution_clock::now();
+        _reset();
+        if (_steps.empty() || std::any_of(_symbols.begin(), _symbols.end(), [](const Symbol &s){return s.aligned != s.chart->size();}))
+            _align();
+        _account.curve.reserve(steps());
+        _on_start();
+        for (_step = 0; _step+1 < _steps.size(); _step++){
+            size_t first = _steps[_step], last = _steps[_step+1];
+            for (size_t i = first; i < last; i++) _symbols[_events[i].first].index = _events[i].second;
+            if (threads > 1 && last-first > 1) tasks::parallel_for(first, last, 1, [this](size_t i){_manage(i);}, threads);
+            else for (size_t i = first; i < last; i++) _manage(i);
+            for (size_t i = first; i < last; i++){
+                Book &book = _symbols[_events[i].first].book;
+                for (size_t k : book.closed()) _account.apply(book.trades()[k], risk);
+            }
+            for (size_t i = first; i < last; i++) _on_candle(_events[i].first);
+            bool in_market = false;
+            for (auto &s : _symbols) in_market |= s.book.open_trades() > 0;
+            _account.end_step(in_market);
+        }
+        _run_analysis();
+        _metric.time_taken = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now()-start);
+    }
+
+    //@return number of symbols
+    size_t symbols() const {return _symbols.size();}
+
+    //@return name of a symbol
+    const std::string &name(size_t symbol) const {return _symbols[symbol].name;}
+
+    //@return chart of a symbol
+    Chart &chart(size_t symbol) {return *_symbols[symbol].chart;}
+
+    //@return candles of a symbol
+    std::vector<CandleStick> &candles(size_t symbol) {return _symbols[symbol].chart->candles();}
+
+    //@return index of the current candle of a symbol. SIZE_MAX if the symbol has no candle yet
+    size_t index(size_t symbol) const {return _symbols[symbol].index;}
+
+    //@return index of the current step
+    size_t step() const {return _step;}
+
+    //@return number of steps i.e number of distinct timestamps
+    size_t steps() const {return _steps.empty() ? 0 : _steps.size()-1;}
+
+    //@return timestamp of the current step
+    time_t timestamp() const {return _times[_step];}
+
+    //@return the strategy
+    strategy_type &strategy() {return _strategy;}
+
+    //@return current equity
+    Quantity equity() const {return _account.equity;}
+
+    //@return Returns of the strategy @note Not in percentage
+    float returns() const {return _metric.returns;}
+
+    //@return The accuracy of the strategy @note Not in percentage
+    float winrate() const {return ((float) (_metric.short_wins+_metric.long_wins))/_metric.n_trades;}
+
+    //@return The maximum drawdown @note Not in percentage
+    float max_dd() const {return _account.max_dd;}
+
+    /*@return Sharpe ratio of the returns per step. 0 if it is undefined
+    @param periods number of steps in the period it is scaled to. 1 means per step
+    */
+    double sharpe(double periods = 1) const {return _account.sharpe(periods);}
+
+    /*@return Sortino ratio of the returns per step. 0 if it is undefined
+    @param periods number of steps in the period it is scaled to. 1 means per step
+    */
+    double sortino(double periods = 1) const {return _account.sortino(periods);}
+
+    //@return returns over the absolute maximum drawdown. 0 if there was no drawdown
+    double calmar() const {return _account.calmar();}
+
+    //@return gross profit over gross loss. 0 if there was no loss
+    double profit_factor() const {return _account.profit_factor();}
+
+    //@return average reward to risk of a trade
+    double expectancy() const {return _account.expectancy();}
+
+    //@return fraction of the steps that ended with a trade open on any symbol @note Not in percentage
+    double exposure() const {return _account.exposure();}
+
+    //@return equity and drawdown at the end of each step
+    const std::vector<EquityPoint> &equity_curve() const {return _account.curve;}
+
+    /*Writes the equity curve of the last run. See Account::write_curve()
+    @param file_path path of the file. A .csv file is written as text, any other file in binary form
+    */
+    void export_equity(const char *file_path) const {
+        _account.write_curve(file_path, [this](size_t i){return _times[i];});
+    }
+
+    //@return A const reference to the trades taken on a symbol
+    const std::vector<Trade> &trades(size_t symbol) const {return _symbols[symbol].book.trades();}
+
+    /*Adds an order on a symbol. Market orders are filled at the close of the current candle of the symbol
+    @return true if the order was added. Orders on a symbol without a candle yet are ignored
+    @note every order should have a stop loss and take profit
+    */
+    bool add_order(size_t symbol, Order &order){
+        Symbol &s = _symbols[symbol];
+        if (s.index == SIZE_MAX) return false;
+        return s.book.add_order(order, s.index);
+    }
+
+    bool add_order(size_t symbol, Order &&order){
+        return add_order(symbol, order);
+    }
+
+    /*@brief Prints statistical information about the strategy backtested to the console, in total and per symbol*/
+    void print_stat(){
+        std::ios cout_state(nullptr);
+        cout_state.copyfmt(std::cout); // To reset the console later
+        std::cout << std::setprecision(4);
+        std::cout << "strategy name: " << _strategy_name << '\n'
+        << "winrate : " << ((_metric.n_trades > 0 ? (float) (_metric.short_wins+_metric.long_wins)/_metric.n_trades : 0) *100)
+        << "%\tnumber of trades : " << _metric.n_trades
+        << "\nmax drawdown : " << _account.max_dd*100  << "%\tmax drawdown (duration) : " << _account.max_dd_duration << " steps"
+        << "\nlongs : " << _metric.longs << "\t\tshorts : " << _metric.shorts
+        << "\nlongs winrate : " << ((_metric.longs > 0? ((float) _metric.long_wins)/ _metric.longs : 0)*100) << "%\tshorts winrate : "
+        << (_metric.shorts > 0 ? ((float) _metric.short_wins)/ _metric.shorts : 0) *100
+        << "%\nreturns : " << _metric.returns*100 << "%\ttime taken : " << _metric.time_taken.count() << " ms\tnumber of steps : " << steps()
+        << "\nsharpe : " << sharpe() << "\tsortino : " << sortino() << "\tcalmar : " << calmar()
+        << "\nprofit factor : " << profit_factor() << "\texpectancy : " << expectancy() << " R\texposure : " << exposure()*100 << "%\n";
+        for (auto &s : _symbols){
+            std::cout << s.name << "\ttrades : " << s.n_trades << "\twinrate : " << (s.n_trades > 0 ? (float) s.wins/s.n_trades : 0)*100
+            << "%\treward to risk : " << s.risk_reward << "\tcandles : " << s.chart->size() << "\n";
+        }
+        std::cout.copyfmt(cout_state);
+    }
+
+private:
+    std::deque<Symbol> _symbols;
+    strategy_type _strategy;
+    std::string _strategy_name;
+    Account _account;
+    PerformanceMetric _metric;
+    size_t _step = 0;
+    std::vector<time_t> _times; //Timestamp of each step
+    std::vector<size_t> _steps; //Events of step i are in [_steps[i], _steps[i+1])
+    std::vector<std::pair<size_t, size_t>> _events; //(symbol, index of the candle)
+
+    void _on_start(){
+        if constexpr (requires(strategy_type &s, BasicPortfolio &engine){ s.on_start(engine); }) _strategy.on_start(*this);
+    }
+
+    void _on_candle(size_t symbol){
+        if constexpr (requires(strategy_type &s, BasicPortfolio &engine){ s.on_candle(engine, symbol); }) _strategy.on_candle(*this, symbol);
+        else _strategy(*this, symbol);
+    }
+
+    //Checks the trades and orders of the symbol of an event
+    void _manage(size_t event){
+        Symbol &s = _symbols[_events[event].first];
+        s.book.manage_trades(s.index);
+        s.book.manage_orders(s.index);
+    }
+
+    /*Builds the alignment index. Candles are merged by timestamp with a k-way merge, candles with the same timestamp form a step.
+    A symbol appears at most once in a step, a repeated timestamp in a chart starts a new step*/
+    void _align(){
+        using Item = std::pair<time_t, size_t>; //(timestamp, symbol)
+        std::priority_queue<Item, std::vector<Item>, std::greater<Item>> heap;
+        std::vector<size_t> next(_symbols.size(), 0), last_step(_symbols.size(), SIZE_MAX);
+        _times = {};
+        _events = {};
+        _steps = {};
+        for (size_t s = 0; s < _symbols.size(); s++){
+            _symbols[s].aligned = _symbols[s].chart->size();
+            if (_symbols[s].chart->size() > 0) heap.emplace(_symbols[s].chart->candles()[0].timestamp(), s);
+        }
+        while (!heap.empty()){
+            auto [timestamp, s] = heap.top();
+            heap.pop();
+            if (_times.empty() || _times.back() != timestamp || last_step[s] == _times.size()-1){
+                _times.push_back(timestamp);
+                _steps.push_back(_events.size());
+            }
+            last_step[s] = _times.size()-1;
+            _events.emplace_back(s, next[s]);
+            if (++next[s] < _symbols[s].chart->size()) heap.emplace(_symbols[s].chart->candles()[next[s]].timestamp(), s);
+        }
+        _steps.push_back(_events.size());
+    }
+
+    /*Calculates useful information about the backtest*/
+    void _run_analysis(){
+        for (auto &s : _symbols){
+            for (auto &tr : s.book.trades()){
+                if (!tr.trade_completed) continue;
+                if (tr.success){
+                    if (tr.direction == Direction::sell) _metric.short_wins++;
+                    else _metric.long_wins++;
+                    s.wins++;
+                }
+                if (tr.direction == Direction::sell) ++_metric.shorts;
+                else _metric.longs++;
+                s.risk_reward += tr.rr;
+                s.n_trades++;
+            }
+            _metric.risk_reward += s.risk_reward;
+            _metric.n_trades += s.n_trades;
+        }
+        _metric.returns = _account.returns();
+    }
+
+    /* Resets all private variables.
+    @note Does not reset public variables
+    */
+    void _reset(){
+        for (auto &s : _symbols){
+            s.book.reset();
+            s.index = SIZE_MAX;
+            s.wins = s.n_trades = 0;
+            s.risk_reward = 0;
+        }
+        _account.reset();
+        _metric = {};
+        _step = 0;
+    }
+};
+
+template <typename S>
+BasicPortfolio(S, const char * = "") -> BasicPortfolio<S>;
+
+BasicPortfolio(void (*) (BasicPortfolio<> &, size_t), const char * = "") -> BasicPortfolio<>;
+
+/*Portfolio engine whose strategy is a function void (*)(Portfolio &, size_t)*/
+using Portfolio = BasicPortfolio<>;
@@ -0,0 +1,271 @@
+/*
+This file contains code to replay recorded trades through the live path (see live.hpp), e.g to check a strategy and its latency before
+running it live
+Config = speed of the replay
+EventLog = candles, orders and trades of a replay as lines of text, the same for every run of the same data
+Replay = reads trades with a data handler and releases them to a live::Runtime at the pace of their timestamps
+
+The trades are released at the pace of RowData::timestamp: trade i is released at start + (timestamp(i) - timestamp(0))/speed, whatever
+the time the trades before it took to process, so a slow candle doesn't shift the rest of the replay. At speed 0 the trades are released
+as soon as they are read.
+*/
+#pragma once
+
+#include "defs.hpp"
+#include "rowdata.hpp"
+#include "data.hpp"
+#include "source.hpp"
+#include "order.hpp"
+#include "live.hpp"
+#include "histogram.hpp"
+#include <chrono>
+#include <thread>
+#include <optional>
+#include <charconv>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+
+namespace replay{
+
+    /*Parameters of a replay
+    @param speed 1 = real time, N = N times faster, 0 = as fast as possible
+    @param skip number of lines to skip at the start of each file e.g column names
+    */
+    struct Config{
+        double speed = 0;
+        size_t skip = 0;
+    };
+
+    /*Events of a replay, one per line:
+        candle,index,timestamp,open,high,low,close,levels      when the strategy has run on a candle
+        order,index,direction,type,entry,sl,tp,tag             when the strategy adds an order on the candle at index
+        trade,timestamp,direction,entry,sl,tp,tag,success,completed      every trade, at the end of the replay
+    The log doesn't contain times measured during the replay, so two runs of the same data and strategy give the same log at any
+    speed. Compare two logs with first_difference() or diff.
+    */
+    class EventLog{
+    public:
+        void candle(size_t index, CandleStick &candle){
+            _text("candle,");
+            _field(index);
+            _field((long long) candle.timestamp());
+            _field(candle.open());
+            _field(candle.high());
+            _field(candle.low());
+            _field(candle.close());
+            _last(candle.footprint().size());
+        }
+
+        void order(size_t index, const Order &order){
+            _text("order,");
+            _field(index);
+            _text(order.direction == Direction::buy ? "buy," : "sell,");
+            _text(order.order_type == OrderType::market_order ? "market," : "limit,");
+            _field(order.entry);
+            _field(order.sl);
+            _field(order.tp);
+            _last(order.tag);
+        }
+
+        void trade(const Trade &trade){
+            _text("trade,");
+            _field((long long) trade.timestamp);
+            _text(trade.direction == Direction::buy ? "buy," : "sell,");
+            _field(trade.entry);
+            _field(trade.sl);
+            _field(trade.tp);
+            _field(trade.tag);
+            _field((int) trade.success);
+            _last((int) trade.trade_completed);
+        }
+
+        //@return the events as text
+        const std::string &str() const {return _text_log;}
+
+        //@return number of events
+        size_t size() const {return _events;}
+
+        //@return FNV-1a hash of the log, to compare runs without keeping the logs
+        uint64_t digest() const {
+            uint64_t h = 14695981039346656037ull;
+            for (unsigned char c : _text_log) h = (h ^ c) * 1099511628211ull;
+            return h;
+        }
+
+        //Writes the log to a text file
+        void save(const char *file_path) const {
+            std::ofstream file(file_path);
+            if (!file) throw std::logic_error("cause = EventLog::save() : File not opened\n");
+            file.write(_text_log.data(), _text_log.size());
+        }
+
+        void clear(){
+            _text_log.clear();
+            _events = 0;
+        }
+
+    private:
+        std::string _text_log;
+        size_t _events = 0;
+
+        void _text(std::string_view s){_text_log.append(s);}
+
+        template <typename T>
+        void _number(T x){
+            char buf[32];
+            _text_log.append(buf, std::to_chars(buf, buf+sizeof(buf), x).ptr);
+        }
+
+        template <typename T>
+        void _field(T x){
+            _number(x);
+            _text_log.push_back(',');
+        }
+
+        template <typename T>
+        void _last(T x){
+            _number(x);
+            _text_log.push_back('\n');
+            _events++;
+        }
+    };
+
+    /*@return index of the first line that differs between two event logs, or SIZE_MAX if they are the same*/
+    inline size_t first_difference(const EventLog &a, const EventLog &b){
+        std::string_view x = a.str(), y = b.str();
+        size_t line = 0, i = 0;
+        while (i < x.size() && i < y.size() && x[i] == y[i]){
+            if (x[i] == '\n') line++;
+            i++;
+        }
+        return i == x.size() && i == y.size() ? SIZE_MAX : line;
+    }
+
+    /*Replays recorded trades through a live::Runtime, i.e the same aggregation and strategy path as live trading, and records:
+        trade_latency() : time from the release of a trade to the end of the decision on it
+        candle_latency() : same for the trades that closed a candle
+        lag() : time from the release of a trade to the moment the replay got to it, when the replay is paced
+        log() : the events of the replay (see EventLog)
+    At speed 0 a trade is released once it is parsed. Several files can be replayed in a row with run(), e.g one file per day, then
+    finish() adds the last candle and the trades to the log.
+    @param engine engine the strategy runs on. Its chart can contain history to warm the strategy up
+    @param price_level_interval the price difference between each price level
+    @param time_interval time interval (in seconds)
+    @param config speed of the replay
+    @tparam Engine a BasicBackTest
+    */
+    template <typename Engine>
+    class Replay{
+    public:
+        Replay(Engine &engine, const Price price_level_interval, const int time_interval, const Config &config = {}) : _engine(engine),
+        _config(config), _sink(std::move(engine.order_sink)){
+            _engine.order_sink = [this](const Order &order){
+                _log.order(_engine.index(), order);
+                if (_sink) _sink(order);
+            };
+            _runtime.emplace(engine, price_level_interval, time_interval);
+            _log_candles();
+        }
+
+        Replay(const Replay &) = delete;
+
+        Replay &operator=(const Replay &) = delete;
+
+        //Gives the order sink back to the engine
+        ~Replay(){
+            _engine.order_sink = std::move(_sink);
+        }
+
+        /*Replays the trades of a file
+        @param path location of the file, read the same way as aggregator::aggregate()
+        @param handler data handler e.g handler::binary_handler
+        @return number of trades replayed
+        */
+        size_t run(const std::string &path, RowData (*handler) (data::FileStream &)){
+            using clock = std::chrono::steady_clock;
+            data::FileStream file;
+            data::open_input(file, path);
+            for (size_t i = 0; i < _config.skip; i++){
+                std::string _;
+                getline(file, _);
+            }
+            const size_t start = _runtime->rows();
+            auto t0 = clock::now();
+            while (!file.eof()){
+                RowData row = handler(file);
+                if (file.fail()) break; // Nothing was read, the previous line was the last one
+                auto now = clock::now(), released = now;
+                if (_config.speed > 0){
+                    if (!_paced){
+                        _origin = row.timestamp;
+                        _start = now;
+                        _paced = true;
+                    }
+                    released = _start + std::chrono::nanoseconds((int64_t) ((row.timestamp - _origin) * 1e6 / _config.speed));
+                    if (released > now){ // Sleeping wakes up tens of microseconds late, the end of the wait is spent yielding
+                        if (released-now > _spin) std::this_thread::sleep_until(released-_spin);
+                        while ((now = clock::now()) < released) std::this_thread::yield();
+                    }
+                    _lag.record(now > released ? std::chrono::duration_cast<std::chrono::nanoseconds>(now-released).count() : 0);
+                }
+                _runtime->on_row(row, released);
+                _log_candles();
+            }
+            _duration += clock::now()-t0;
+            data::check_input(file);
+            return _runtime->rows()-start;
+        }
+
+        /*Adds the candle being built to the chart, runs the strategy on it and computes the statistics of the engine (see
+        BasicBackTest::finish()). The trades are added to the log*/
+        void finish(){
+            _runtime->flush();
+            _log_candles();
+            _engine.finish();
+            for (const Trade &tr : _engine.trades()) _log.trade(tr);
+        }
+
+        //@return the events of the replay
+        const EventLog &log() const {return _log;}
+
+        //@return the runtime the trades are released to
+        live::Runtime<Engine> &runtime() {return *_runtime;}
+
+        //@return number of trades replayed
+        size_t rows() const {return _runtime->rows();}
+
+        //@return time spent in run(), in seconds
+        double duration() const {return std::chrono::duration<double>(_duration).count();}
+
+        //@return see live::Runtime::trade_latency()
+        const LatencyHistogram &trade_latency() const {return _runtime->trade_latency();}
+
+        //@return see live::Runtime::candle_latency()
+        const LatencyHistogram &candle_latency() const {return _runtime->candle_latency();}
+
+        //@return how late the trades were picked up after their release time. Empty at speed 0
+        const LatencyHistogram &lag() const {return _lag;}
+
+    private:
+        static constexpr std::chrono::microseconds _spin{200};
+
+        Engine &_engine;
+        Config _config;
+        std::function<void (const Order &)> _sink; //Order sink of the engine before the replay
+        std::optional<live::Runtime<Engine>> _runtime;
+        EventLog _log;
+        LatencyHistogram _lag;
+        size_t _logged = 0; //Candles in the log
+        bool _paced = false;
+        time_t _origin = 0; //Timestamp of the first trade
+        std::chrono::steady_clock::time_point _start; //Release time of the first trade
+        std::chrono::steady_clock::duration _duration{0};
+
+        void _log_candles(){
+            for (; _logged < _engine.steps(); _logged++) _log.candle(_logged, _engine.candles()[_logged]);
+        }
+    };
+}
+//namespace end
@@ -0,0 +1,384 @@
+/*
+This file contains the task scheduler shared by the library
+Scheduler = pool of threads with one deque of tasks per thread. Idle threads steal tasks from the others
+TaskGroup = set of tasks that can be waited on, with an optional limit on the tasks running at the same time
+parallel_for = calls a function on every index of a range using the threads of a scheduler
+global/ configure = the scheduler used by the library and its settings
+
+The threads of the library (aggregating many files, generating data, checking the books of a portfolio, building profiles and
+indicators, running several backtests) are taken from tasks::global() instead of being created by each function, so a process never
+runs more compute threads than configured. Threads blocked on I/O for their whole life (e.g the reader of an input file) are not tasks
+and keep their own thread.
+*/
+#pragma once
+
+#include "defs.hpp"
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <exception>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+namespace tasks{
+
+    /*Pool of threads executing tasks. Each thread pops the tasks it submits from the back of its own deque (the most recent, whose
+    data is still in cache) and steals from the front of the deques of the other threads when its deque is empty. Tasks submitted from
+    outside the pool go to a shared queue.
+    @param threads number of threads. 0 uses std::thread::hardware_concurrency()
+    @param cpus cpus the threads are pinned to, thread i runs on cpus[i % cpus.size()]. Empty doesn't pin the threads.
+    Pinning is only supported on linux and ignored elsewhere
+    */
+    class Scheduler{
+    public:
+        using Task = std::function<void()>;
+
+        explicit Scheduler(size_t threads = 0, std::vector<int> cpus = {}){
+            if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+            for (size_t i = 0; i < threads; i++) _workers.emplace_back(new _Worker);
+            for (size_t i = 0; i < threads; i++){
+                int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+                _workers[i]->thread = std::thread([this, i, cpu](){_loop(i, cpu);});
+            }
+        }
+
+        Scheduler(const Scheduler &) = delete;
+
+        Scheduler &operator=(const Scheduler &) = delete;
+
+        /*Waits for the tasks already submitted to finish and stops the threads*/
+        ~Scheduler(){
+            {
+                std::lock_guard<std::mutex> lock(_mut);
+                _stop = true;
+            }
+            _cv.notify_all();
+            for (auto &w : _workers) w->thread.join();
+        }
+
+        //@return number of threads of the pool
+        size_t threads() const {return _workers.size();}
+
+        /*Adds a task. The task should not throw, use a TaskGroup to get the exceptions of tasks*/
+        void submit(Task task){
+            if (_current == this) {
+                _Worker &w = *_workers[_index];
+                std::lock_guard<std::mutex> lock(w.mut);
+                w.tasks.push_back(std::move(task));
+            }
+            else {
+                std::lock_guard<std::mutex> lock(_mut);
+                _injected.push_back(std::move(task));
+            }
+            _pending.fetch_add(1);
+            { std::lock_guard<std::mutex> lock(_mut); } // A thread checking _pending under _mut either sees it or is notified
+            _cv.notify_one();
+        }
+
+        /*Runs one pending task on the calling thread. Used by threads waiting on tasks, so that a wait inside a task can't deadlock the pool
+        @return true if a task was run
+        */
+        bool run_one(){
+            Task task;
+            if (!_pop(_current == this ? _index : SIZE_MAX, task)) return false;
+            task();
+            return true;
+        }
+
+    private:
+        struct _Worker{
+            std::mutex mut;
+            std::deque<Task> tasks;
+            std::thread thread;
+        };
+
+        std::vector<std::unique_ptr<_Worker>> _workers;
+        std::mutex _mut;
+        std::condition_variable _cv;
+        std::deque<Task> _injected;
+        std::atomic<size_t> _pending = 0;
+        bool _stop = false;
+
+        static inline thread_local Scheduler *_current = nullptr;
+        static inline thread_local size_t _index = 0;
+
+        /*@brief Takes a task from the deque of the thread self, then from the shared queue, then from the other threads
+        @param self index of the calling thread. SIZE_MAX if it isn't a thread of the pool
+        */
+        bool _pop(size_t self, Task &task){
+            if (_pending.load() == 0) return false;
+            if (self != SIZE_MAX){
+                _Worker &w = *_workers[self];
+                std::lock_guard<std::mutex> lock(w.mut);
+                if (!w.tasks.empty()){
+                    task = std::move(w.tasks.back());
+                    w.tasks.pop_back();
+                    _pending.fetch_sub(1);
+                    return true;
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(_mut);
+                if (!_injected.empty()){
+                    task = std::move(_injected.front());
+                    _injected.pop_front();
+                    _pending.fetch_sub(1);
+                    return true;
+                }
+            }
+            const size_t n = _workers.size(), first = (self == SIZE_MAX) ? 0 : self+1;
+            for (size_t k = 0; k < n; k++){
+                size_t victim = (first+k) % n;
+                if (victim == self) continue;
+                _Worker &w = *_workers[victim];
+                std::lock_guard<std::mutex> lock(w.mut);
+                if (!w.tasks.empty()){
+                    task = std::move(w.tasks.front());
+                    w.tasks.pop_front();
+                    _pending.fetch_sub(1);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void _loop(size_t i, int cpu){
+            _current = this;
+            _index = i;
+#ifdef __linux__
+            if (cpu >= 0){
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            }
+#else
+            (void) cpu;
+#endif
+            while (true){
+                Task task;
+                if (_pop(i, task)){
+                    task();
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(_mut);
+                if (_stop && _pending.load() == 0) return;
+                _cv.wait(lock, [&](){return _stop || _pending.load() > 0;});
+            }
+        }
+    };
+
+    //Settings of the global scheduler. Not in an unnamed namespace, every translation unit should see the same settings
+    struct __Settings__{
+        size_t threads = 0;
+        std::vector<int> cpus;
+        bool started = false;
+        std::mutex mut;
+    };
+
+    inline __Settings__ &__settings__(){
+        static __Settings__ settings;
+        return settings;
+    }
+
+    /*@return the scheduler used by the library. It is created with the settings of configure() on the first call*/
+    inline Scheduler &global(){
+        static Scheduler *scheduler = [](){
+            __Settings__ &s = __settings__();
+            std::lock_guard<std::mutex> lock(s.mut);
+            s.started = true;
+            return new Scheduler(s.threads, s.cpus); // Never destroyed, tasks may still be waited on during static destruction
+        }();
+        return *scheduler;
+    }
+
+    /*Sets the number of threads of the global scheduler and the cpus they are pinned to, e.g to leave cpus to other processes of a
+    production box. Should be called before the library uses the scheduler.
+    @param threads number of threads. 0 uses std::thread::hardware_concurrency()
+    @param cpus see Scheduler
+    */
+    inline void configure(size_t threads, std::vector<int> cpus = {}){
+        __Settings__ &s = __settings__();
+        std::lock_guard<std::mutex> lock(s.mut);
+        if (s.started) throw std::logic_error("cause = configure() : the global scheduler is already running\n");
+        s.threads = threads;
+        s.cpus = std::move(cpus);
+    }
+
+    /*Set of tasks that can be waited on. The first exception thrown by a task is rethrown by wait(), and the tasks of the group that
+    haven't started yet are skipped once a task has thrown or the group is cancelled.
+    @param scheduler scheduler running the tasks
+    @param max_concurrency maximum number of tasks of the group running at the same time, the others wait in the group. 0 = no limit
+    @note The destructor cancels the tasks that haven't started and waits for the others without rethrowing their exception
+    */
+    class TaskGroup{
+    public:
+        explicit TaskGroup(Scheduler &scheduler = global(), size_t max_concurrency = 0) : _scheduler(scheduler), _limit(max_concurrency){}
+
+        TaskGroup(const TaskGroup &) = delete;
+
+        TaskGroup &operator=(const TaskGroup &) = delete;
+
+        ~TaskGroup(){
+            cancel();
+            try {
+                wait();
+            }
+            catch (...) {}
+        }
+
+        /*Adds a task to the group
+        @param f function taking no argument
+        */
+        template <typename F>
+        void run(F &&f){
+            std::unique_lock<std::mutex> lock(_mut);
+            _pending++;
+            if (_limit > 0 && _running >= _limit){
+                _queue.emplace_back(std::forward<F>(f));
+                return;
+            }
+            _running++;
+            lock.unlock();
+            _submit(Scheduler::Task(std::forward<F>(f)));
+        }
+
+        /*Skips the tasks of the group that haven't started yet*/
+        void cancel(){
+            _cancelled.store(true);
+        }
+
+        /*Waits until pred() is true or a task has thrown. The calling thread runs pending tasks in the meantime. pred is checked after
+        each task of the group ends
+        @return pred()
+        */
+        template <typename Pred>
+        bool wait_until(Pred pred){
+            while (true){
+                {
+                    std::unique_lock<std::mutex> lock(_mut);
+                    if (pred()) return true;
+                    if (_error) return false;
+                }
+                if (_scheduler.run_one()) continue;
+                std::unique_lock<std::mutex> lock(_mut);
+                _cv.wait_for(lock, std::chrono::milliseconds(1), [&](){return _error || pred();});
+            }
+        }
+
+        /*Waits for all the tasks of the group. Rethrows the first exception thrown by a task*/
+        void wait(){
+            while (true){
+                {
+                    std::lock_guard<std::mutex> lock(_mut);
+                    if (_pending == 0) break;
+                }
+                if (_scheduler.run_one()) continue;
+                std::unique_lock<std::mutex> lock(_mut);
+                _cv.wait_for(lock, std::chrono::milliseconds(1), [&](){return _pending == 0;});
+            }
+            std::exception_ptr error;
+            {
+                std::lock_guard<std::mutex> lock(_mut);
+                std::swap(error, _error);
+            }
+            _cancelled.store(false);
+            if (error) std::rethrow_exception(error);
+        }
+
+    private:
+        Scheduler &_scheduler;
+        size_t _limit, _pending = 0, _running = 0;
+        std::deque<Scheduler::Task> _queue;
+        std::mutex _mut;
+        std::condition_variable _cv;
+        std::exception_ptr _error;
+        std::atomic<bool> _cancelled = false;
+
+        void _submit(Scheduler::Task f){
+            _scheduler.submit([this, f = std::move(f)](){
+                if (!_cancelled.load()){
+                    try {
+                        f();
+                    }
+                    catch (...) {
+                        std::lock_guard<std::mutex> lock(_mut);
+                        if (!_error) _error = std::current_exception();
+                        _cancelled.store(true);
+                    }
+                }
+                Scheduler::Task next;
+                {
+                    std::lock_guard<std::mutex> lock(_mut);
+                    if (!_queue.empty()){
+                        next = std::move(_queue.front());
+                        _queue.pop_front();
+                    }
+                    else _running--;
+                    _pending--;
+                    _cv.notify_all(); // Last use of the group, it may be destroyed once _mut is released
+                }
+                if (next) _submit(std::move(next));
+            });
+        }
+    };
+
+    /*@brief Calls f(i) for every i in [first, last). The range is cut in chunks of grain indexes which are taken in order by the calling
+    thread and by up to max_concurrency-1 tasks of the scheduler. Returns when every index is done, and rethrows the first exception
+    thrown by f, in which case the chunks not yet taken are skipped.
+    @param grain number of indexes per chunk. Should make a chunk long enough to amortize taking it (a few microseconds)
+    @param max_concurrency maximum number of threads calling f, including the calling thread. 0 = threads of the scheduler + 1
+    */
+    template <typename F>
+    void parallel_for(size_t first, size_t last, size_t grain, F &&f, size_t max_concurrency = 0, Scheduler &scheduler = global()){
+        if (first >= last) return;
+        grain = std::max<size_t>(1, grain);
+        const size_t chunks = (last-first+grain-1)/grain;
+        size_t workers = std::min(chunks, scheduler.threads()+1);
+        if (max_concurrency > 0) workers = std::min(workers, max_concurrency);
+        if (workers <= 1){
+            for (size_t i = first; i < last; i++) f(i);
+            return;
+        }
+        std::atomic<size_t> next = 0;
+        auto body = [&](){
+            try {
+                for (size_t c = next.fetch_add(1); c < chunks; c = next.fetch_add(1)){
+                    size_t end = std::min(last, first+(c+1)*grain);
+                    for (size_t i = first+c*grain; i < end; i++) f(i);
+                }
+            }
+            catch (...) {
+                next.store(chunks);
+                throw;
+            }
+        };
+        TaskGroup group(scheduler);
+        for (size_t w = 1; w < workers; w++) group.run(body);
+        std::exception_ptr error;
+        try {
+            body();
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        if (error){
+            try {
+                group.wait();
+            }
+            catch (...) {}
+            std::rethrow_exception(error);
+        }
+        group.wait();
+    }
+}
+//namespace end
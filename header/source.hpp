@@ -0,0 +1,286 @@
+/*
+This file contains the input sources the aggregator reads time and sales data from.
+InputSource = a source of raw bytes e.g a plain file or a gzip/zip archive that is decompressed while it is read
+PipeBuf = a stream buffer filled by a dedicated thread, so reading and decompressing overlap with parsing
+
+Compressed archives need zlib: define ORDERFLOW_ZLIB (e.g compile with -DORDERFLOW_ZLIB) and link with -lz. Without it only plain files can
+be read.
+*/
+#pragma once
+
+#include "defs.hpp"
+#include "data.hpp"
+#include <streambuf>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cstring>
+#include <deque>
+
+#ifdef ORDERFLOW_ZLIB
+#include <zlib.h>
+#endif
+
+namespace data{
+
+    /*Source of raw bytes*/
+    class InputSource{
+    public:
+        virtual ~InputSource() = default;
+
+        /*Reads at most n bytes into buf.
+        @return number of bytes read. 0 means the end of the source
+        */
+        virtual size_t read(char *buf, size_t n) = 0;
+    };
+
+    /*Reads a file as it is*/
+    class FileSource : public InputSource{
+    public:
+        FileSource(const std::string &path){
+            _file.open(path, std::ios::in | std::ios::binary);
+            if (!_file) throw std::logic_error("cause = FileSource() : No such file\n");
+        }
+
+        size_t read(char *buf, size_t n) override {
+            _file.read(buf, n);
+            return _file.gcount();
+        }
+
+    private:
+        std::ifstream _file;
+    };
+
+#ifdef ORDERFLOW_ZLIB
+    /*Decompresses a gzip file. Files with several gzip members (e.g concatenated with cat) are read as one stream*/
+    class GzipSource : public InputSource{
+    public:
+        GzipSource(const std::string &path) : _in(1 << 18){
+            _file.open(path, std::ios::in | std::ios::binary);
+            if (!_file) throw std::logic_error("cause = GzipSource() : No such file\n");
+            if (inflateInit2(&_zs, 15+32) != Z_OK) throw std::runtime_error("cause = GzipSource() : inflateInit2 failed\n");
+        }
+
+        ~GzipSource(){inflateEnd(&_zs);}
+
+        size_t read(char *buf, size_t n) override {
+            _zs.next_out = reinterpret_cast<Bytef *>(buf);
+            _zs.avail_out = n;
+            while (_zs.avail_out > 0 && !_done){
+                if (_zs.avail_in == 0){
+                    _file.read(_in.data(), _in.size());
+                    _zs.next_in = reinterpret_cast<Bytef *>(_in.data());
+                    _zs.avail_in = _file.gcount();
+                    if (_zs.avail_in == 0){
+                        if (_member) throw std::runtime_error("cause = GzipSource::read() : Truncated gzip file\n");
+                        _done = true;
+                        break;
+                    }
+                }
+                _member = true;
+                int ret = inflate(&_zs, Z_NO_FLUSH);
+                if (ret == Z_STREAM_END){
+                    _member = false;
+                    if (_zs.avail_in == 0 && _file.peek() == std::char_traits<char>::eof()) _done = true;
+                    else inflateReset(&_zs); // Next gzip member
+                }
+                else if (ret != Z_OK && ret != Z_BUF_ERROR) throw std::runtime_error("cause = GzipSource::read() : Corrupt gzip data\n");
+            }
+            return n-_zs.avail_out;
+        }
+
+    private:
+        std::ifstream _file;
+        std::vector<char> _in;
+        z_stream _zs{};
+        bool _done = false;
+        bool _member = false; //A gzip member was started and not finished
+    };
+
+    /*Decompresses the first file in a zip archive. Exchange archives e.g binance contain a single csv*/
+    class ZipSource : public InputSource{
+    public:
+        ZipSource(const std::string &path) : _in(1 << 18){
+            _file.open(path, std::ios::in | std::ios::binary);
+            if (!_file) throw std::logic_error("cause = ZipSource() : No such file\n");
+
+            unsigned char header[30];
+            _file.read(reinterpret_cast<char *>(header), sizeof(header));
+            if (_file.gcount() != sizeof(header) || _u32(header) != 0x04034b50)
+                throw std::runtime_error("cause = ZipSource() : Not a zip archive\n");
+            _method = _u16(header+8);
+            _remaining = _u32(header+18); // compressed size
+            _file.seekg(_u16(header+26) + _u16(header+28), std::ios::cur); // file name and extra field
+
+            if (_method == 8){
+                if (inflateInit2(&_zs, -15) != Z_OK) throw std::runtime_error("cause = ZipSource() : inflateInit2 failed\n");
+            }
+            else if (_method != 0 || (_u16(header+6) & 8)) throw std::runtime_error("cause = ZipSource() : Unsupported compression method\n");
+        }
+
+        ~ZipSource(){if (_method == 8) inflateEnd(&_zs);}
+
+        size_t read(char *buf, size_t n) override {
+            if (_method == 0){ // stored
+                if (n > _remaining) n = _remaining;
+                _file.read(buf, n);
+                _remaining -= _file.gcount();
+                return _file.gcount();
+            }
+            _zs.next_out = reinterpret_cast<Bytef *>(buf);
+            _zs.avail_out = n;
+            while (_zs.avail_out > 0 && !_done){
+                if (_zs.avail_in == 0){
+                    _file.read(_in.data(), _in.size());
+                    _zs.next_in = reinterpret_cast<Bytef *>(_in.data());
+                    _zs.avail_in = _file.gcount();
+                    if (_zs.avail_in == 0) throw std::runtime_error("cause = ZipSource::read() : Truncated zip archive\n");
+                }
+                int ret = inflate(&_zs, Z_NO_FLUSH);
+                if (ret == Z_STREAM_END) _done = true;
+                else if (ret != Z_OK && ret != Z_BUF_ERROR) throw std::runtime_error("cause = ZipSource::read() : Corrupt zip data\n");
+            }
+            return n-_zs.avail_out;
+        }
+
+    private:
+        std::ifstream _file;
+        std::vector<char> _in;
+        z_stream _zs{};
+        int _method = 0;
+        size_t _remaining = 0;
+        bool _done = false;
+
+        static uint32_t _u16(const unsigned char *p){return p[0] | (p[1] << 8);}
+        static uint32_t _u32(const unsigned char *p){return _u16(p) | (_u16(p+2) << 16);}
+    };
+#endif
+
+    /*Stream buffer filled by a dedicated thread. The thread reads (and decompresses) blocks from an InputSource while the
+    reading thread parses the previous blocks. An error of the source ends the stream, like the end of the source, and is kept so the
+    reader can rethrow it once it has stopped (see check_input()). Throwing from underflow() wouldn't work, the stream would catch it
+    and the reader would only see the end of the file.
+    @param source source of the bytes
+    @param block_size size of a block in bytes
+    @param blocks number of blocks. The thread stops reading when all blocks are filled and not yet parsed
+    */
+    class PipeBuf : public std::streambuf{
+    public:
+        PipeBuf(std::unique_ptr<InputSource> source, size_t block_size = 1 << 20, size_t blocks = 4) : _source(std::move(source)){
+            for (size_t i = 0; i < blocks; i++) _free.push_back(std::vector<char>(block_size));
+            _worker = std::thread(&PipeBuf::_produce, this);
+        }
+
+        ~PipeBuf(){
+            {
+                std::lock_guard<std::mutex> lock(_mut);
+                _stop = true;
+            }
+            _cv.notify_all();
+            _worker.join();
+        }
+
+    protected:
+        int_type underflow() override {
+            if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+            std::unique_lock<std::mutex> lock(_mut);
+            if (!_current.empty()) _free.push_back(std::move(_current)); // Give the parsed block back to the thread
+            _cv.notify_all();
+            _cv.wait(lock, [this](){return !_ready.empty() || _finished;});
+            if (_ready.empty()) return traits_type::eof(); // The end of the source or an error, see rethrow()
+            _current = std::move(_ready.front().first);
+            size_t n = _ready.front().second;
+            _ready.pop_front();
+            setg(_current.data(), _current.data(), _current.data()+n);
+            return traits_type::to_int_type(*gptr());
+        }
+
+    public:
+        //Rethrows the error that ended the stream, if any
+        void rethrow(){
+            std::lock_guard<std::mutex> lock(_mut);
+            if (_error) std::rethrow_exception(_error);
+        }
+
+    private:
+        std::unique_ptr<InputSource> _source;
+        std::thread _worker;
+        std::mutex _mut;
+        std::condition_variable _cv;
+        std::deque<std::vector<char>> _free;
+        std::deque<std::pair<std::vector<char>, size_t>> _ready;
+        std::vector<char> _current;
+        std::exception_ptr _error;
+        bool _stop = false, _finished = false;
+
+        void _produce(){
+            try {
+                while (true){
+                    std::vector<char> block;
+                    {
+                        std::unique_lock<std::mutex> lock(_mut);
+                        _cv.wait(lock, [this](){return !_free.empty() || _stop;});
+                        if (_stop) break;
+                        block = std::move(_free.front());
+                        _free.pop_front();
+                    }
+                    size_t n = 0, r;
+                    while (n < block.size() && (r = _source->read(block.data()+n, block.size()-n)) > 0) n += r;
+                    std::lock_guard<std::mutex> lock(_mut);
+                    if (n > 0) _ready.emplace_back(std::move(block), n);
+                    _cv.notify_all();
+                    if (n < block.size()) break;
+                }
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(_mut);
+                _error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(_mut);
+            _finished = true;
+            _cv.notify_all();
+        }
+    };
+
+    /*@brief Opens a source based on the extension of the file. .gz files are read as gzip, .zip files as zip and any other file as it is
+    @param path location of the file
+    @return the source
+    */
+    inline std::unique_ptr<InputSource> open_source(const std::string &path){
+        std::string ext = std::filesystem::path(path).extension().string();
+        if (ext == ".gz" || ext == ".zip"){
+#ifdef ORDERFLOW_ZLIB
+            if (ext == ".gz") return std::make_unique<GzipSource>(path);
+            return std::make_unique<ZipSource>(path);
+#else
+            throw std::logic_error("cause = open_source() : Compressed files need ORDERFLOW_ZLIB defined and zlib\n");
+#endif
+        }
+        return std::make_unique<FileSource>(path);
+    }
+
+    /*@brief Opens a file for reading by a data handler. Compressed archives (.gz, .zip) are decompressed on a dedicated thread
+    while the data is being parsed. Other files are opened as they are, .bin files in binary mode.
+    @param file stream to open
+    @param path location of the file
+    */
+    inline void open_input(FileStream &file, const std::string &path){
+        std::string ext = std::filesystem::path(path).extension().string();
+        if (ext != ".gz" && ext != ".zip"){
+            file.open_except(path, ext == ".bin" ? std::ios::in | std::ios::binary : std::ios::in);
+            return;
+        }
+        file.attach(std::make_unique<PipeBuf>(open_source(path)));
+    }
+
+    /*@brief Rethrows the error that ended a file opened with open_input(), e.g corrupt gzip data. Call it after the last row is read, the
+    data handlers see an error as the end of the file
+    @param file stream opened with open_input()
+    */
+    inline void check_input(FileStream &file){
+        if (auto *buf = dynamic_cast<PipeBuf *>(static_cast<std::ios &>(file).rdbuf())) buf->rethrow(); // fstream::rdbuf() is the file buffer
+    }
+}
@@ -1,6 +1,7 @@
 #include "header/aggregator.hpp"
 #include "header/chart.hpp"
 #include <filesystem>
+#include <chrono>
 
 using namespace std;
 
@@ -11,10 +12,10 @@ int main(){
     const Price price_interval = 8;
     size_t cols = 6;
     double file_size = filesystem::file_size(file_path)/(1024.0*1024);
-    time_t start = time(0);
+    auto start = chrono::steady_clock::now();
     size_t line = aggregator::aggregate_store(file_path, handler::binance_handler, store_path, price_interval, time_interval, 0);
-    size_t duration = time(0)-start;
-    cout << "speed : " << file_size/duration << " MB/s";
+    double duration = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    cout << "speed : " << file_size/duration << " MB/s\tlines : " << line << "\ttime taken : " << duration << " s";
     return 0;
 }
 
@@ -0,0 +1,167 @@
+/*
+This file contains a small benchmark harness used by benchmark.cpp
+Result = timing statistics of a benchmark
+measure = runs a benchmark with warmup and repetitions
+do_not_optimize = keeps the compiler from removing a computation whose result is unused
+*/
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <cmath>
+
+namespace bench{
+
+    /*Timing statistics of a benchmark. Times are in nanoseconds
+    @param name name of the benchmark
+    @param size size of the input e.g number of rows
+    @param items number of items processed in one repetition. Used for the throughput
+    */
+    struct Result{
+        std::string name;
+        size_t size = 0;
+        size_t items = 0;
+        size_t reps = 0;
+        double min = 0, mean = 0, p50 = 0, p90 = 0, p99 = 0, max = 0;
+
+        //@return items processed per second, using the median
+        double throughput() const {return p50 > 0 ? items*1e9/p50 : 0;}
+
+        //@return key used to match a result against the baseline
+        std::string key() const {return name + "/" + std::to_string(size);}
+    };
+
+    namespace {
+        //@return nearest-rank percentile of sorted samples
+        inline double __percentile__(const std::vector<double> &sorted, double p){
+            size_t rank = (size_t) std::ceil(p*sorted.size());
+            return sorted[rank > 0 ? rank-1 : 0];
+        }
+    }
+
+    inline volatile double __sink__ = 0;
+
+    //Stores value in a volatile, so the computation of value can't be optimized away
+    inline void do_not_optimize(double value){
+        __sink__ = value;
+    }
+
+    /*@brief Runs a benchmark.
+    @param name name of the benchmark
+    @param size size of the input
+    @param items number of items processed by one call of f
+    @param f function to benchmark
+    @param reps number of timed repetitions
+    @param warmup number of untimed repetitions before the timed ones
+    @param setup function called before each repetition. It is not timed
+    @return statistics of the timed repetitions
+    */
+    template <typename F, typename S>
+    Result measure(const std::string &name, size_t size, size_t items, F &&f, size_t reps, size_t warmup, S &&setup){
+        for (size_t i = 0; i < warmup; i++){
+            setup();
+            f();
+        }
+        std::vector<double> samples;
+        for (size_t i = 0; i < reps; i++){
+            setup();
+            auto start = std::chrono::steady_clock::now();
+            f();
+            samples.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now()-start).count());
+        }
+        std::sort(samples.begin(), samples.end());
+
+        Result res;
+        res.name = name;
+        res.size = size;
+        res.items = items;
+        res.reps = reps;
+        res.min = samples.front();
+        res.max = samples.back();
+        for (double x : samples) res.mean += x/samples.size();
+        res.p50 = __percentile__(samples, 0.5);
+        res.p90 = __percentile__(samples, 0.9);
+        res.p99 = __percentile__(samples, 0.99);
+        return res;
+    }
+
+    template <typename F>
+    Result measure(const std::string &name, size_t size, size_t items, F &&f, size_t reps = 10, size_t warmup = 2){
+        return measure(name, size, items, f, reps, warmup, [](){});
+    }
+
+    /*@brief Prints a result to the console*/
+    inline void print(const Result &r){
+        std::cout << std::left << std::setw(28) << r.name << std::right << std::setw(10) << r.size
+        << std::fixed << std::setprecision(3)
+        << "  p50 " << std::setw(10) << r.p50/1e6 << " ms  p90 " << std::setw(10) << r.p90/1e6 << " ms  p99 " << std::setw(10) << r.p99/1e6
+        << " ms  " << std::setprecision(0) << std::setw(12) << r.throughput() << " items/s\n" << std::defaultfloat;
+    }
+
+    /*@brief Writes results as JSON. Each result is on its own line, which read_json() relies on*/
+    inline void write_json(const std::string &path, const std::vector<Result> &results){
+        std::ofstream out(path);
+        if (!out) throw std::logic_error("cause = write_json() : File not opened\n");
+        out << std::setprecision(10) << "[\n";
+        for (size_t i = 0; i < results.size(); i++){
+            const Result &r = results[i];
+            out << "{\"name\": \"" << r.name << "\", \"size\": " << r.size << ", \"items\": " << r.items << ", \"reps\": " << r.reps
+            << ", \"min_ns\": " << r.min << ", \"mean_ns\": " << r.mean << ", \"p50_ns\": " << r.p50 << ", \"p90_ns\": " << r.p90
+            << ", \"p99_ns\": " << r.p99 << ", \"max_ns\": " << r.max << ", \"items_per_sec\": " << r.throughput() << "}"
+            << (i+1 < results.size() ? ",\n" : "\n");
+        }
+        out << "]\n";
+    }
+
+    /*@brief Reads results written by write_json()
+    @return median time of each result, keyed by Result::key()
+    */
+    inline std::map<std::string, double> read_json(const std::string &path){
+        std::ifstream in(path);
+        if (!in) throw std::logic_error("cause = read_json() : File not opened\n");
+        std::map<std::string, double> res;
+        std::string line;
+        auto field = [&](const std::string &name) -> std::string {
+            size_t pos = line.find("\"" + name + "\": ");
+            if (pos == std::string::npos) return "";
+            pos += name.size() + 4;
+            size_t end = line.find_first_of(",}", pos);
+            std::string x = line.substr(pos, end-pos);
+            if (!x.empty() && x.front() == '"') x = x.substr(1, x.size()-2);
+            return x;
+        };
+        while (std::getline(in, line)){
+            std::string name = field("name"), size = field("size"), p50 = field("p50_ns");
+            if (name.empty() || size.empty() || p50.empty()) continue;
+            res[name + "/" + size] = std::stod(p50);
+        }
+        return res;
+    }
+
+    /*@brief Compares results against a stored baseline and prints the benchmarks whose median time grew by more than threshold
+    @param results current results
+    @param baseline baseline read with read_json()
+    @param threshold allowed slowdown e.g 0.1 = 10%
+    @return number of regressions
+    */
+    inline size_t compare(const std::vector<Result> &results, const std::map<std::string, double> &baseline, double threshold){
+        size_t regressions = 0;
+        for (const Result &r : results){
+            auto it = baseline.find(r.key());
+            if (it == baseline.end() || it->second <= 0) continue;
+            double change = r.p50/it->second - 1;
+            bool regressed = change > threshold;
+            regressions += regressed;
+            std::cout << (regressed ? "REGRESSION " : "           ") << std::left << std::setw(40) << r.key() << std::right
+            << std::showpos << std::fixed << std::setprecision(1) << change*100 << "%\n" << std::noshowpos << std::defaultfloat;
+        }
+        return regressions;
+    }
+}
@@ -0,0 +1,129 @@
+#include "header/aggregator.hpp"
+#include "header/backtest.hpp"
+#include "header/generator.hpp"
+#include "bench.hpp"
+#include <filesystem>
+#include <cstring>
+
+using namespace std;
+
+/*
+Benchmark suite of the aggregation, loading, market profile and backtesting code.
+It runs on generated data (see generator.hpp) at several sizes, so it doesn't need any file.
+
+usage: benchmark [--sizes 10000,100000,1000000] [--reps 10] [--json result.json] [--baseline baseline.json] [--threshold 0.1]
+--json writes the results as JSON. --baseline compares the results against a JSON written previously and returns 1 if a median
+time grew by more than --threshold.
+*/
+
+// Moving average cross strategy used to benchmark the backtest engine
+void sma_cross(BackTest &self){
+    size_t i = self.index();
+    if (i == 0) return;
+    const vector<Price> &fast = self.chart().select_indicator("sma_close_10"), &slow = self.chart().select_indicator("sma_close_50");
+    CandleStick &x = self.candles()[i];
+    Price range = max<Price>(x.high()-x.low(), 1);
+    if (fast[i-1] <= slow[i-1] && fast[i] > slow[i]) self.add_order(Order(x.close(), x.close()-range, x.close()+2*range, Direction::buy, OrderType::market_order));
+    if (fast[i-1] >= slow[i-1] && fast[i] < slow[i]) self.add_order(Order(x.close(), x.close()+range, x.close()-2*range, Direction::sell, OrderType::market_order));
+    if (i % 7 == 0) self.add_order(Order(x.low(), x.low()-range, x.low()+range, Direction::buy, OrderType::limit, 10));
+}
+
+int main(int argc, char **argv){
+    vector<size_t> sizes = {10'000, 100'000, 1'000'000};
+    size_t reps = 10;
+    string json_path, baseline_path;
+    double threshold = 0.1;
+    for (int i = 1; i+1 < argc; i += 2){
+        if (!strcmp(argv[i], "--sizes")){
+            sizes.clear();
+            stringstream ss(argv[i+1]);
+            string x;
+            while (getline(ss, x, ',')) sizes.push_back(stoull(x));
+        }
+        else if (!strcmp(argv[i], "--reps")) reps = stoull(argv[i+1]);
+        else if (!strcmp(argv[i], "--json")) json_path = argv[i+1];
+        else if (!strcmp(argv[i], "--baseline")) baseline_path = argv[i+1];
+        else if (!strcmp(argv[i], "--threshold")) threshold = stod(argv[i+1]);
+    }
+
+    const filesystem::path dir = filesystem::temp_directory_path() / "orderflow_bench";
+    filesystem::create_directories(dir);
+    const Price price_interval = 2;
+    const int time_interval = 1; // Small interval so the chart and backtest benchmarks have enough candles
+    vector<bench::Result> results;
+    auto add = [&](const bench::Result &r){
+        bench::print(r);
+        results.push_back(r);
+    };
+
+    for (size_t n : sizes){
+        const string csv = (dir / ("trades_" + to_string(n) + ".csv")).string();
+        const string txt = (dir / ("candles_" + to_string(n) + ".txt")).string();
+        const string bin = (dir / ("candles_" + to_string(n) + ".bin")).string();
+        generator::write_csv(csv, n);
+
+        add(bench::measure("handler::binance_handler", n, n, [&](){
+            data::FileStream file;
+            file.open_except(csv, ios::in);
+            double sum = 0;
+            for (size_t i = 0; i < n; i++) sum += handler::binance_handler(file).price;
+            bench::do_not_optimize(sum);
+        }, reps));
+
+        add(bench::measure("SafeQueue", n, n, [&](){
+            SafeQueue<RowData> queue;
+            thread producer([&](){
+                for (size_t i = 0; i < n; i++) queue.push(RowData{(time_t) i, 1, true, 1});
+            });
+            for (size_t i = 0; i < n; i++){
+                while (queue.empty());
+                queue.pop();
+            }
+            producer.join();
+        }, reps));
+
+        vector<CandleStick> candles;
+        add(bench::measure("aggregator::aggregate", n, n, [&](){
+            aggregator::aggregate(csv, handler::binance_handler, candles, price_interval, time_interval);
+        }, reps, 1, [&](){candles.clear();}));
+        aggregator::aggregate_store(csv, handler::binance_handler, txt, price_interval, time_interval);
+
+        Chart chart(candles);
+        chart.store_bin(bin.c_str());
+        const size_t n_candles = chart.size();
+
+        add(bench::measure("Chart::load", n, n_candles, [&](){
+            Chart c;
+            c.load(txt.c_str());
+        }, reps));
+
+        add(bench::measure("Chart::load_bin", n, n_candles, [&](){
+            Chart c;
+            c.load_bin(bin.c_str());
+        }, reps));
+
+        add(bench::measure("Profile::set_fp", n, n_candles, [&](){
+            double sum = 0;
+            for (size_t i = 0; i < n_candles; i++){
+                Profile p;
+                p.set_fp(chart[i].footprint());
+                sum += p.vah();
+            }
+            bench::do_not_optimize(sum);
+        }, reps));
+
+        Chart copy; // Copied before each repetition, so only the indicator is timed
+        add(bench::measure("Chart::apply_sma", n, n_candles, [&](){copy.apply_sma(50);}, reps, 2, [&](){copy = chart;}));
+        add(bench::measure("Chart::apply_std", n, n_candles, [&](){copy.apply_std(20);}, reps, 2, [&](){copy = chart;}));
+
+        chart.apply_sma(10);
+        chart.apply_sma(50);
+        BackTest btest(chart, sma_cross, "sma cross");
+        add(bench::measure("BackTest::run", n, n_candles, [&](){btest.run();}, reps));
+    }
+    filesystem::remove_all(dir);
+
+    if (!json_path.empty()) bench::write_json(json_path, results);
+    if (!baseline_path.empty() && bench::compare(results, bench::read_json(baseline_path), threshold) > 0) return 1;
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include "header/aggregator.hpp"
+#include "header/book.hpp"
+#include "header/generator.hpp"
+#include <filesystem>
+#include <random>
+#include <queue>
+#include <algorithm>
+#include <tuple>
+#include <cstring>
+
+using namespace std;
+
+/*
+Checks Book against a reference engine on random order streams. The reference keeps limit orders in priority queues until price
+reaches them, then drops the expired ones, and checks every open trade on every candle, as the engine did before the timing wheel and
+the range index. The queries of RangeIndex are also checked against a linear search, on charts of sizes around its block size.
+It runs on generated data (see generator.hpp), so it doesn't need any file.
+
+usage: book_check [--rows 400000] [--seeds 20]
+Returns 1 if the trades differ for a seed or a query of RangeIndex is wrong.
+*/
+
+// Reference engine. Same rules as Book: highest buy and lowest sell limits fill first, the stop loss is checked first
+class ReferenceBook{
+public:
+    ReferenceBook(const vector<CandleStick> &candles) : _candles(&candles){}
+
+    void add_order(Order &order, size_t index){
+        const CandleStick &candle = (*_candles)[index];
+        if ((order.entry <= order.sl || order.tp <= order.entry) && order.direction == Direction::buy) return;
+        if ((order.entry >= order.sl || order.tp >= order.entry) && order.direction == Direction::sell) return;
+        if (order.order_type == OrderType::limit && order.direction == Direction::buy && order.entry > candle.close()) return;
+        if (order.order_type == OrderType::limit && order.direction == Direction::sell && order.entry < candle.close()) return;
+        order.entry_id = index;
+        if (order.order_type == OrderType::market_order){
+            order.entry = candle.close();
+            _fill(order, index);
+        }
+        else if (order.direction == Direction::buy) _buy_limit.push(order);
+        else _sell_limit.push(order);
+    }
+
+    void manage_trades(size_t index){
+        const CandleStick &candle = (*_candles)[index];
+        for (Trade &tr : _trades){
+            if (tr.trade_completed) continue;
+            bool buy = tr.direction == Direction::buy;
+            if ((buy && candle.low() < tr.sl) || (!buy && candle.high() > tr.sl)){
+                tr.trade_completed = true;
+                tr.rr = -1;
+            }
+            else if ((!buy && candle.low() < tr.tp) || (buy && candle.high() > tr.tp)){
+                tr.trade_completed = tr.success = true;
+                tr.rr = buy ? (tr.tp-tr.entry)/ (tr.entry-tr.sl) : (tr.entry-tr.tp)/ (tr.sl-tr.entry);
+            }
+        }
+    }
+
+    void manage_orders(size_t index){
+        const CandleStick &candle = (*_candles)[index];
+        while (!_buy_limit.empty() && candle.low() <= _buy_limit.top().entry){
+            if (index - _buy_limit.top().entry_id <= _buy_limit.top().cancel_after) _fill(_buy_limit.top(), index);
+            _buy_limit.pop();
+        }
+        while (!_sell_limit.empty() && candle.high() >= _sell_limit.top().entry){
+            if (index - _sell_limit.top().entry_id <= _sell_limit.top().cancel_after) _fill(_sell_limit.top(), index);
+            _sell_limit.pop();
+        }
+    }
+
+    const vector<Trade> &trades() const {return _trades;}
+
+private:
+    const vector<CandleStick> *_candles;
+    vector<Trade> _trades;
+    priority_queue<Order, vector<Order>> _buy_limit; //Descending
+    priority_queue<Order, vector<Order>, greater<Order>> _sell_limit; //Ascending
+
+    void _fill(const Order &od, size_t index){
+        _trades.emplace_back(od.entry, od.sl, od.tp, (*_candles)[index].timestamp(), od.direction, "", od.tag); // od is popped after the fill
+    }
+};
+
+/*@return true if both engines took the same trades with the same results, in the same order. Orders with the same entry filled on the
+same candle can come in any order, the priority queues of the reference don't keep the order of equal entries, so only their tags are
+compared as a set*/
+bool same_trades(vector<Trade> a, vector<Trade> b){
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++){
+        if (a[i].entry != b[i].entry || a[i].timestamp != b[i].timestamp || a[i].direction != b[i].direction || a[i].rr != b[i].rr ||
+            a[i].success != b[i].success || a[i].trade_completed != b[i].trade_completed) return false;
+    }
+    auto order = [](const Trade &l, const Trade &r){
+        return tie(l.timestamp, l.direction, l.entry, l.tag) < tie(r.timestamp, r.direction, r.entry, r.tag);
+    };
+    sort(a.begin(), a.end(), order);
+    sort(b.begin(), b.end(), order);
+    for (size_t i = 0; i < a.size(); i++) if (a[i].tag != b[i].tag) return false;
+    return true;
+}
+
+/*@brief Checks RangeIndex against a linear search on a random walk of n candles
+@return number of wrong queries
+*/
+size_t check_range_index(size_t n, mt19937 &rng){
+    vector<CandleStick> candles;
+    Price p = 1000;
+    for (size_t i = 0; i < n; i++){
+        p += (int) (rng() % 21) - 10;
+        candles.emplace_back(p, p + rng() % 10, p - rng() % 10, p, (time_t) i);
+    }
+    RangeIndex index;
+    index.build(candles);
+    size_t wrong = 0;
+    for (int q = 0; q < 20'000; q++){
+        size_t first = rng() % (n+2);
+        Price level = 1000 + (int) (rng() % 400) - 200;
+        size_t low = n, high = n;
+        for (size_t k = first; k < n && low == n; k++) if (candles[k].low() < level) low = k;
+        for (size_t k = first; k < n && high == n; k++) if (candles[k].high() > level) high = k;
+        wrong += index.first_low_below(first, level) != low || index.first_high_above(first, level) != high;
+    }
+    return wrong;
+}
+
+int main(int argc, char **argv){
+    size_t rows = 400'000, seeds = 20;
+    for (int i = 1; i+1 < argc; i += 2){
+        if (!strcmp(argv[i], "--rows")) rows = stoull(argv[i+1]);
+        else if (!strcmp(argv[i], "--seeds")) seeds = stoull(argv[i+1]);
+    }
+
+    const filesystem::path dir = filesystem::temp_directory_path() / "orderflow_check";
+    filesystem::create_directories(dir);
+    const string bin = (dir / "trades.bin").string();
+    generator::write_bin(bin, rows);
+    Chart chart;
+    aggregator::aggregate(bin, handler::binary_handler, chart, 5, 10);
+    filesystem::remove_all(dir);
+    const vector<CandleStick> &candles = chart.candles();
+
+    size_t failed = 0;
+    for (size_t seed = 0; seed < seeds; seed++){
+        // Up to 5 limit orders per candle, up to 20$ from the close. Some never expire, the others expire at different ages
+        Book book(candles);
+        ReferenceBook reference(candles);
+        mt19937 rng(seed);
+        size_t max_pending = 0;
+        for (size_t i = 0; i < candles.size(); i++){
+            book.manage_trades(i);
+            reference.manage_trades(i);
+            book.manage_orders(i);
+            reference.manage_orders(i);
+            max_pending = max(max_pending, book.pending_orders());
+            for (size_t k = rng() % 6; k > 0; k--){
+                const CandleStick &x = candles[i];
+                Price offset = (rng() % 200)/10.0f;
+                size_t cancel_after = rng() % 4 == 0 ? SIZE_MAX : rng() % (seed*30+1);
+                Order order = rng() % 2 ?
+                    Order(x.close()-offset, x.close()-offset-5, x.close()-offset+5, Direction::buy, OrderType::limit, cancel_after, "", i) :
+                    Order(x.close()+offset, x.close()+offset+5, x.close()+offset-5, Direction::sell, OrderType::limit, cancel_after, "", i);
+                Order copy = order;
+                book.add_order(order, i);
+                reference.add_order(copy, i);
+            }
+        }
+        bool same = same_trades(book.trades(), reference.trades());
+        failed += !same;
+        cout << "seed : " << seed << "\ttrades : " << book.trades().size() << "\treference : " << reference.trades().size()
+            << "\tmax pending : " << max_pending << "\t" << (same ? "same" : "DIFFERENT") << "\n";
+    }
+    cout << "candles : " << candles.size() << "\tfailed seeds : " << failed << "\n";
+
+    mt19937 rng(3);
+    size_t wrong = 0;
+    for (size_t n : {0, 1, 63, 64, 65, 1000, 100'000}){
+        size_t w = check_range_index(n, rng);
+        wrong += w;
+        cout << "RangeIndex candles : " << n << "\twrong queries : " << w << "\n";
+    }
+    return failed > 0 || wrong > 0;
+}
@@ -0,0 +1,37 @@
+#include "header/generator.hpp"
+#include <cstring>
+#include <chrono>
+
+using namespace std;
+
+/*
+Writes generated binance formatted trades, e.g for benchmarks on machines without data.
+
+usage: generate <path> [--rows 1000000 | --bytes 1000000000] [--seed 1] [--rate 20] [--threads 0]
+Files ending with .bin are written in binary form (see handler::binary_handler), other files in csv.
+*/
+
+int main(int argc, char **argv){
+    if (argc < 2){
+        cout << "usage: generate <path> [--rows n | --bytes n] [--seed n] [--rate trades_per_sec] [--threads n]\n";
+        return 1;
+    }
+    const string path = argv[1];
+    const bool binary = path.size() >= 4 && path.substr(path.size()-4) == ".bin";
+    size_t rows = 1'000'000;
+    unsigned threads = 0;
+    generator::Config config;
+    for (int i = 2; i+1 < argc; i += 2){
+        if (!strcmp(argv[i], "--rows")) rows = stoull(argv[i+1]);
+        else if (!strcmp(argv[i], "--bytes")) rows = stoull(argv[i+1]) / (binary ? 17 : 70); // Approximate size of a row
+        else if (!strcmp(argv[i], "--seed")) config.seed = stoull(argv[i+1]);
+        else if (!strcmp(argv[i], "--rate")) config.trades_per_sec = stod(argv[i+1]);
+        else if (!strcmp(argv[i], "--threads")) threads = stoul(argv[i+1]);
+    }
+
+    auto start = chrono::steady_clock::now();
+    size_t bytes = binary ? generator::write_bin(path, rows, config, threads) : generator::write_csv(path, rows, config, threads);
+    double duration = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    cout << "rows : " << rows << "\tsize : " << bytes/(1024.0*1024) << " MB\tspeed : " << bytes/(1024.0*1024)/duration << " MB/s\n";
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "header/live.hpp"
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+/*
+Runs a strategy on trades received live. The trades are read in binary form (see handler::binary_handler) from a file, a named pipe, a
+unix socket or the standard input, e.g
+    mkfifo trades && ./live trades &
+    ./recorder > trades
+or to paper trade a recorded day at full speed
+    ./live - < day.bin
+
+usage: live [path | -] [--socket] [--history candles.txt]
+The orders of the strategy are written to the standard output as they are added, followed by the statistics and the latencies.
+*/
+
+/*
+Delta is a strategy object that buys after a candle with a strong positive delta and sells after a strong negative one. The same object
+runs unchanged in BasicBackTest::run(). on_trade is only called live, on every trade, e.g to watch the candle being built.
+*/
+struct Delta{
+    Quantity threshold = 0.3; // Minimum delta / volume
+    size_t cooldown = 10, next = 0; // Candles to wait after an order
+    size_t big_trades = 0;
+
+    template <typename Engine>
+    void on_start(Engine &){
+        next = big_trades = 0;
+    }
+
+    template <typename Engine>
+    void on_candle(Engine &self){
+        CandleStick &x = self.candles()[self.index()];
+        Quantity volume = x.volume();
+        Price risk = x.high()-x.low();
+        if (self.index() < next || volume <= 0 || risk <= 0) return;
+        if (x.delta()/volume > threshold)
+            self.add_order(Order(x.close(), x.close()-risk, x.close()+risk, Direction::buy, OrderType::market_order, SIZE_MAX, "", self.index()));
+        else if (x.delta()/volume < -threshold)
+            self.add_order(Order(x.close(), x.close()+risk, x.close()-risk, Direction::sell, OrderType::market_order, SIZE_MAX, "", self.index()));
+        else return;
+        next = self.index() + cooldown;
+    }
+
+    template <typename Engine>
+    void on_trade(Engine &, const RowData &row){
+        if (row.volume >= 10) big_trades++;
+    }
+};
+
+int main(int argc, char **argv){
+    string path = "-", history;
+    bool socket = false;
+    for (int i = 1; i < argc; i++){
+        if (!strcmp(argv[i], "--socket")) socket = true;
+        else if (!strcmp(argv[i], "--history") && i+1 < argc) history = argv[++i];
+        else path = argv[i];
+    }
+
+    Chart chart;
+    if (!history.empty()) chart.load(history.c_str()); // Candles the strategy warms up on
+    BasicBackTest engine(chart, Delta(), "delta");
+    live::Output output;
+    engine.order_sink = [&](const Order &order){output.write(order, engine.candles()[engine.index()].timestamp());};
+
+    live::Runtime runtime(engine, 10, 60); // 10$ price levels, 1 minute candles
+    live::Input in = path == "-" ? live::open_stdin() : socket ? live::connect_unix(path) : live::open_file(path);
+    size_t rows = runtime.run(in);
+    runtime.flush();
+
+    engine.finish();
+    cout << "trades : " << rows << "\tcandles : " << engine.steps() << "\tbig trades : " << engine.strategy().big_trades << "\n";
+    engine.print_stat();
+    cout << "latency per trade\n" << runtime.trade_latency() << "\nlatency per candle close\n" << runtime.candle_latency() << "\n";
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include "header/live.hpp"
+#include "header/portfolio.hpp"
+#include "header/generator.hpp"
+#include <filesystem>
+#include <cstring>
+
+using namespace std;
+
+/*
+Checks the live path and the portfolio engine against BasicBackTest::run() on generated data (see generator.hpp):
+    trades fed one at a time to a live::Runtime give the same candles and trades as run() on the aggregated chart, with and without
+    history candles in the chart
+    a portfolio of one symbol gives the same trades, returns and drawdown as run() on its chart, also when the chart grew after a run
+    a portfolio of several symbols gives the same results with several threads as with one
+It doesn't need any file.
+
+usage: live_check [--rows 300000]
+Returns 1 if a check fails.
+*/
+
+// Adds a market order every 5 candles and a limit order at the low every 3 candles
+template <typename Add>
+void add_orders(const CandleStick &x, size_t i, Add &&add){
+    if (i % 5 == 0) add(Order(x.close(), x.close()-5, x.close()+5, Direction::buy, OrderType::market_order, SIZE_MAX, "", i));
+    if (i % 3 == 0) add(Order(x.low(), x.low()-5, x.low()+5, Direction::buy, OrderType::limit, 10, "", i));
+}
+
+struct Single{
+    template <typename Engine>
+    void on_candle(Engine &self){
+        add_orders(self.candles()[self.index()], self.index(), [&](Order order){self.add_order(order);});
+    }
+};
+
+struct Multi{
+    template <typename Engine>
+    void on_candle(Engine &self, size_t symbol){
+        add_orders(self.candles(symbol)[self.index(symbol)], self.index(symbol), [&](Order order){self.add_order(symbol, order);});
+    }
+};
+
+//@return true if both lists have the same trades in the same order
+bool same_trades(const vector<Trade> &a, const vector<Trade> &b){
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++){
+        if (a[i].entry != b[i].entry || a[i].timestamp != b[i].timestamp || a[i].tag != b[i].tag || a[i].rr != b[i].rr ||
+            a[i].success != b[i].success || a[i].trade_completed != b[i].trade_completed) return false;
+    }
+    return true;
+}
+
+//@return true if both charts have the same candles
+bool same_candles(Chart &a, Chart &b){
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++){
+        if (a[i].timestamp() != b[i].timestamp() || a[i].open() != b[i].open() || a[i].high() != b[i].high() || a[i].low() != b[i].low() ||
+            a[i].close() != b[i].close() || a[i].volume() != b[i].volume() || a[i].footprint().size() != b[i].footprint().size()) return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv){
+    size_t rows = 300'000;
+    for (int i = 1; i+1 < argc; i += 2){
+        if (!strcmp(argv[i], "--rows")) rows = stoull(argv[i+1]);
+    }
+    const Price price_interval = 5;
+    const int time_interval = 10;
+
+    const filesystem::path dir = filesystem::temp_directory_path() / "orderflow_check";
+    filesystem::create_directories(dir);
+    const string bin = (dir / "trades.bin").string();
+    generator::write_bin(bin, rows);
+    Chart chart;
+    aggregator::aggregate(bin, handler::binary_handler, chart, price_interval, time_interval);
+    vector<RowData> trades;
+    {
+        data::FileStream file;
+        data::open_input(file, bin);
+        while (true){
+            RowData row = handler::binary_handler(file);
+            if (file.fail()) break;
+            trades.push_back(row);
+        }
+    }
+    filesystem::remove_all(dir);
+
+    BasicBackTest backtest(chart, Single());
+    backtest.run();
+    size_t failed = 0;
+
+    // The trades of the candles after the history are fed to the runtime
+    for (size_t history : {(size_t) 0, chart.size()/2}){
+        Chart live_chart;
+        for (size_t i = 0; i < history; i++) live_chart.push_back(chart[i]);
+        // The engine runs on its own copy of the chart
+        BasicBackTest engine(live_chart, Single());
+        live::Runtime runtime(engine, price_interval, time_interval);
+        const time_t start = history < chart.size() ? chart[history].timestamp() : 0;
+        for (const RowData &row : trades) if (row.timestamp >= start) runtime.on_row(row);
+        runtime.flush();
+        engine.finish();
+        bool ok = same_candles(chart, engine.chart()) && same_trades(backtest.trades(), engine.trades());
+        failed += !ok;
+        cout << "live, history : " << history << "\tcandles : " << engine.chart().size() << "\ttrades : " << engine.trades().size()
+            << "\trun() : " << backtest.trades().size() << "\t" << (ok ? "same" : "DIFFERENT") << "\n";
+    }
+
+    BasicPortfolio<Multi> portfolio(Multi{});
+    portfolio.add_symbol("A", chart);
+    portfolio.run();
+    bool ok = same_trades(backtest.trades(), portfolio.trades(0)) && backtest.returns() == portfolio.returns() &&
+        backtest.max_dd() == portfolio.max_dd();
+    failed += !ok;
+    cout << "portfolio of one symbol\ttrades : " << portfolio.trades(0).size() << "\treturns : " << portfolio.returns() << "\trun() : "
+        << backtest.returns() << "\t" << (ok ? "same" : "DIFFERENT") << "\n";
+
+    // A chart grown after a run is aligned again on the next run
+    Chart grown;
+    for (size_t i = 0; i < chart.size()/2; i++) grown.push_back(chart[i]);
+    BasicPortfolio<Multi> growing(Multi{});
+    growing.add_symbol("A", grown);
+    growing.run();
+    for (size_t i = chart.size()/2; i < chart.size(); i++) grown.push_back(chart[i]);
+    growing.run();
+    ok = same_trades(backtest.trades(), growing.trades(0)) && backtest.returns() == growing.returns();
+    failed += !ok;
+    cout << "portfolio of a grown chart	steps : " << growing.steps() << "	trades : " << growing.trades(0).size() << "	"
+        << (ok ? "same" : "DIFFERENT") << "\n";
+
+    // The second symbol has the same candles, the third starts later and ends earlier
+    Chart same = chart, part;
+    for (size_t i = 7; i < chart.size()/2; i++) part.push_back(chart[i]);
+    BasicPortfolio<Multi> several(Multi{});
+    several.add_symbol("A", chart);
+    several.add_symbol("B", same);
+    several.add_symbol("C", part);
+    several.risk = 0.0005;
+    several.run();
+    float one_thread = several.returns();
+    several.threads = 3;
+    several.run();
+    ok = one_thread == several.returns();
+    failed += !ok;
+    cout << "portfolio of 3 symbols\treturns : " << one_thread << "\t3 threads : " << several.returns() << "\t" << (ok ? "same" : "DIFFERENT")
+        << "\n";
+    return failed > 0;
+}
@@ -0,0 +1,78 @@
+#include "header/replay.hpp"
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+/*
+Replays recorded trades through the live path (see test/live.cpp) and reports the latencies. The event log of a run can be saved and
+compared with the log of another run, e.g before and after a change of the strategy, at any speed
+    replay day.bin --speed 0 --log before.txt
+    replay day.bin --speed 60 --compare before.txt
+
+usage: replay <path> [--speed 0] [--log events.txt] [--compare events.txt]
+Files ending with .bin are read with handler::binary_handler, other files with handler::binance_handler.
+*/
+
+/*
+Breakout buys when a candle closes above the high of the previous n candles and sells when it closes below their low
+*/
+struct Breakout{
+    size_t n = 20;
+
+    template <typename Engine>
+    void on_candle(Engine &self){
+        size_t i = self.index();
+        if (i < n) return;
+        Price high = self.candles()[i-n].high(), low = self.candles()[i-n].low();
+        for (size_t k = i-n+1; k < i; k++){
+            high = max(high, self.candles()[k].high());
+            low = min(low, self.candles()[k].low());
+        }
+        CandleStick &x = self.candles()[i];
+        Price risk = high-low;
+        if (x.close() > high) self.add_order(Order(x.close(), x.close()-risk, x.close()+risk, Direction::buy, OrderType::market_order, SIZE_MAX, "", i));
+        else if (x.close() < low) self.add_order(Order(x.close(), x.close()+risk, x.close()-risk, Direction::sell, OrderType::market_order, SIZE_MAX, "", i));
+    }
+};
+
+int main(int argc, char **argv){
+    if (argc < 2){
+        cout << "usage: replay <path> [--speed 0] [--log events.txt] [--compare events.txt]\n";
+        return 1;
+    }
+    const string path = argv[1];
+    const bool binary = path.size() >= 4 && path.substr(path.size()-4) == ".bin";
+    replay::Config config;
+    string log_path, compare_path;
+    for (int i = 2; i+1 < argc; i += 2){
+        if (!strcmp(argv[i], "--speed")) config.speed = stod(argv[i+1]);
+        else if (!strcmp(argv[i], "--log")) log_path = argv[i+1];
+        else if (!strcmp(argv[i], "--compare")) compare_path = argv[i+1];
+    }
+
+    Chart chart;
+    BasicBackTest engine(chart, Breakout(), "breakout");
+    replay::Replay replayer(engine, 10, 60, config); // 10$ price levels, 1 minute candles
+    size_t rows = replayer.run(path, binary ? handler::binary_handler : handler::binance_handler);
+    replayer.finish();
+
+    cout << "trades : " << rows << "\tduration : " << replayer.duration() << " s\tevents : " << replayer.log().size()
+        << "\tdigest : " << hex << replayer.log().digest() << dec << "\n";
+    engine.print_stat();
+    cout << "latency per trade\n" << replayer.trade_latency() << "\nlatency per candle close\n" << replayer.candle_latency() << "\n";
+    if (config.speed > 0) cout << "lag\n" << replayer.lag() << "\n";
+    if (!log_path.empty()) replayer.log().save(log_path.c_str());
+    if (!compare_path.empty()){
+        ifstream file(compare_path);
+        string before((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        const string &after = replayer.log().str();
+        if (before == after) cout << "same events as " << compare_path << "\n";
+        else {
+            size_t i = mismatch(before.begin(), before.end(), after.begin(), after.end()).first - before.begin();
+            cout << "events differ from " << compare_path << " at line " << count(before.begin(), before.begin()+i, '\n')+1 << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "header/aggregator.hpp"
+#include "header/backtest.hpp"
+#include "header/generator.hpp"
+#include <filesystem>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+/*
+Checks the vectorized mode of the backtest engine (BasicBackTest::run(const Signals &)) against run() with a strategy adding the same
+orders, on random signal sets: market and limit orders, with and without expiry, with equal entries on nearby candles. The trades and
+statistics should be bit-identical. It runs on generated data (see generator.hpp), so it doesn't need any file.
+
+usage: signals_check [--rows 400000] [--seeds 40]
+Returns 1 if the results differ for a seed.
+*/
+
+// Adds the order of the signals on each candle, like a strategy computing them one candle at a time
+struct SignalStrategy{
+    const Signals *signals = nullptr;
+
+    template <typename Engine>
+    void on_candle(Engine &self){
+        size_t i = self.index();
+        const Signals &s = *signals;
+        if (!s.direction[i]) return;
+        self.add_order(Order(s.entry[i], s.sl[i], s.tp[i], s.direction[i] > 0 ? Direction::buy : Direction::sell, s.order_type,
+            s.cancel_after, "", i));
+    }
+};
+
+//@return true if both are equal or both are NaN e.g the winrate without trades
+bool same(double a, double b){
+    return a == b || (isnan(a) && isnan(b));
+}
+
+int main(int argc, char **argv){
+    size_t rows = 400'000, seeds = 40;
+    for (int i = 1; i+1 < argc; i += 2){
+        if (!strcmp(argv[i], "--rows")) rows = stoull(argv[i+1]);
+        else if (!strcmp(argv[i], "--seeds")) seeds = stoull(argv[i+1]);
+    }
+
+    const filesystem::path dir = filesystem::temp_directory_path() / "orderflow_check";
+    filesystem::create_directories(dir);
+    const string bin = (dir / "trades.bin").string();
+    generator::write_bin(bin, rows);
+    Chart chart;
+    aggregator::aggregate(bin, handler::binary_handler, chart, 5, 10);
+    filesystem::remove_all(dir);
+    const size_t n = chart.size();
+
+    size_t failed = 0;
+    for (size_t seed = 0; seed < seeds; seed++){
+        // An order on a third of the candles. Entries are rounded so orders on nearby candles share them, a few take profits are on the
+        // wrong side so the orders are rejected
+        mt19937 rng(seed);
+        Signals s(n);
+        s.order_type = seed % 2 ? OrderType::limit : OrderType::market_order;
+        s.cancel_after = seed % 3 == 0 ? SIZE_MAX : rng() % 40;
+        for (size_t i = 0; i < n; i++){
+            if (rng() % 3) continue;
+            const CandleStick &x = chart[i];
+            Price width = 1 + rng() % 30;
+            int d = rng() % 2 ? 1 : -1;
+            Price e = x.close();
+            if (s.order_type == OrderType::limit) e = d > 0 ? x.close()-(rng() % 20)/2.0f : x.close()+(rng() % 20)/2.0f;
+            if (rng() % 10 == 0) e = x.close();
+            e = round(e);
+            s.direction[i] = d;
+            s.entry[i] = e;
+            s.sl[i] = e - d*width;
+            s.tp[i] = e + d*width*(1 + rng() % 3);
+            if (rng() % 50 == 0) s.tp[i] = e - d;
+        }
+
+        BasicBackTest event(chart, SignalStrategy{&s}), vectorized(chart, SignalStrategy{&s});
+        event.run();
+        vectorized.run(s);
+        const vector<Trade> &a = event.trades(), &b = vectorized.trades();
+        bool ok = a.size() == b.size();
+        for (size_t i = 0; ok && i < a.size(); i++){
+            ok = a[i].entry == b[i].entry && a[i].timestamp == b[i].timestamp && a[i].rr == b[i].rr && a[i].success == b[i].success &&
+                a[i].trade_completed == b[i].trade_completed && a[i].tag == b[i].tag;
+        }
+        ok = ok && same(event.returns(), vectorized.returns()) && same(event.max_dd(), vectorized.max_dd()) &&
+            same(event.sharpe(), vectorized.sharpe()) && same(event.exposure(), vectorized.exposure()) &&
+            same(event.winrate(), vectorized.winrate());
+        failed += !ok;
+        cout << "seed : " << seed << "\ttrades : " << a.size() << "\tvectorized : " << b.size() << "\treturns : " << event.returns()
+            << "\tvectorized : " << vectorized.returns() << "\t" << (ok ? "same" : "DIFFERENT") << "\n";
+    }
+
+    // Speed of both modes on market orders
+    mt19937 rng(1);
+    Signals s(n);
+    for (size_t i = 0; i < n; i++){
+        if (rng() % 3) continue;
+        s.direction[i] = 1;
+        s.entry[i] = chart[i].close();
+        s.sl[i] = chart[i].close()-10;
+        s.tp[i] = chart[i].close()+10;
+    }
+    BasicBackTest event(chart, SignalStrategy{&s}), vectorized(chart, SignalStrategy{&s});
+    const int reps = 100;
+    auto t0 = chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++) event.run();
+    auto t1 = chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++) vectorized.run(s);
+    auto t2 = chrono::steady_clock::now();
+    cout << "candles : " << n << "\tfailed seeds : " << failed << "\tevent : " << chrono::duration<double, milli>(t1-t0).count()/reps
+        << " ms\tvectorized : " << chrono::duration<double, milli>(t2-t1).count()/reps << " ms\n";
+    return failed > 0;
+}
@@ -0,0 +1,103 @@
+#include "header/aggregator.hpp"
+#include "header/backtest.hpp"
+#include "header/generator.hpp"
+#include <filesystem>
+#include <cstring>
+
+using namespace std;
+
+/*
+Checks the higher timeframe access of the backtest engine (BasicBackTest::add_timeframe() and htf()) on 1 minute and 1 hour candles
+aggregated from the same generated trades:
+    the last closed hour seen on each minute matches a brute-force search
+    the high of that hour is the maximum high of the minutes already run, i.e no hour is seen before it is closed
+    growing both charts one candle at a time with step() gives the same alignment, except the last minute of an hour which only sees
+    the hour close once the next hour has started
+It runs on generated data (see generator.hpp), so it doesn't need any file.
+
+usage: timeframe_check [--rows 300000]
+Returns 1 if a check fails.
+*/
+
+// Records the index of the last closed hour on each minute
+struct Recorder{
+    size_t id = 1;
+    vector<long long> seen; // -1 if no hour is closed
+    size_t bad = 0;
+
+    template <typename Engine>
+    void on_start(Engine &){
+        seen.clear();
+        bad = 0;
+    }
+
+    template <typename Engine>
+    void on_candle(Engine &self){
+        Timeframe hours = self.htf(id);
+        seen.push_back(hours.empty() ? -1 : (long long) hours.index());
+        if (hours.size() >= 2 && hours[1].timestamp() != self.htf(id)[1].timestamp()) bad++;
+        if (self.htf(0)[0].timestamp() != self.candles()[self.index()].timestamp()) bad++; // Id 0 is the chart of the backtest
+    }
+};
+
+int main(int argc, char **argv){
+    size_t rows = 300'000;
+    for (int i = 1; i+1 < argc; i += 2){
+        if (!strcmp(argv[i], "--rows")) rows = stoull(argv[i+1]);
+    }
+
+    const filesystem::path dir = filesystem::temp_directory_path() / "orderflow_check";
+    filesystem::create_directories(dir);
+    const string bin = (dir / "trades.bin").string();
+    generator::Config config;
+    config.trades_per_sec = 2;
+    generator::write_bin(bin, rows, config);
+    Chart minutes, hours;
+    aggregator::aggregate(bin, handler::binary_handler, minutes, 10, 60);
+    aggregator::aggregate(bin, handler::binary_handler, hours, 10, 3600);
+    filesystem::remove_all(dir);
+
+    BasicBackTest engine(minutes, Recorder());
+    engine.add_timeframe(hours);
+    engine.run();
+    const vector<long long> &seen = engine.strategy().seen;
+    vector<CandleStick> &m = minutes.candles(), &h = hours.candles();
+    const size_t n = m.size();
+
+    // An hour is closed at minute i once the next hour has started by the first trade of minute i+1
+    size_t wrong = 0, early = 0;
+    for (size_t i = 0; i < n; i++){
+        time_t end = i+1 < n ? m[i+1].timestamp() : m[i].timestamp();
+        long long closed = -1;
+        for (size_t k = 0; k+1 < h.size(); k++) if (h[k+1].timestamp() <= end) closed = k;
+        wrong += closed != seen[i];
+        if (closed >= 0){
+            Price high = 0;
+            for (size_t j = 0; j <= i; j++)
+                if (m[j].timestamp() >= h[closed].timestamp() && m[j].timestamp() < h[closed+1].timestamp()) high = max(high, m[j].high());
+            early += high != h[closed].high();
+        }
+    }
+
+    // Same candles added one at a time, an hour is added once its first minute has been
+    Chart live_minutes, live_hours;
+    BasicBackTest live(live_minutes, Recorder());
+    live.add_timeframe(live_hours);
+    live.start();
+    for (size_t i = 0, k = 0; i < n; i++){
+        live.chart().push_back(m[i]);
+        while (k < h.size() && h[k].timestamp() <= m[i].timestamp()) live_hours.push_back(h[k++]);
+        live.step();
+    }
+    const vector<long long> &grown = live.strategy().seen;
+    size_t grow_diff = 0, late = 0;
+    for (size_t i = 0; i < n; i++){
+        late += grown[i] != seen[i];
+        grow_diff += grown[i] != seen[i] && !(i+1 < n && seen[i] == grown[i]+1);
+    }
+
+    size_t bad = engine.strategy().bad + live.strategy().bad;
+    cout << "minutes : " << n << "\thours : " << h.size() << "\twrong alignment : " << wrong << "\thours seen early : " << early
+        << "\tbad views : " << bad << "\tstep() differences : " << grow_diff << "\tlast minutes of an hour : " << late << "\n";
+    return wrong > 0 || early > 0 || bad > 0 || grow_diff > 0;
+}